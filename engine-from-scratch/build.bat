@@ -1,4 +1,4 @@
-set render=src\engine\render\render.c src\engine\render\render_init.c src\engine\render\render_util.c src\engine\animation\animation.c
+set render=src\engine\render\render.c src\engine\render\render_init.c src\engine\render\render_util.c src\engine\render\render_atlas.c src\engine\render\render_debug.c src\engine\render\render_state.c src\engine\animation\animation.c
 set input=src\engine\input\input.c
 set physics=src\engine\physics\physics.c
 set io=src\engine\io\io.c
@@ -6,7 +6,11 @@ set array_list=src\engine\array_list\array_list.c
 set config=src\engine\config\config.c
 set entity=src\engine\entity\entity.c
 set audio=src\engine\audio\audio.c
-set files=src\glad.c src\main.c src\engine\global.c src\engine\time.c %io% %render% %config% %input% %physics% %array_list% %entity% %audio%
+set arena=src\engine\arena\arena.c
+set memory=src\engine\memory\memory.c
+set ecs=src\engine\ecs\ecs.c
+set world=src\engine\world\world.c
+set files=src\glad.c src\main.c src\engine\global.c src\engine\time.c %io% %render% %config% %input% %physics% %array_list% %entity% %audio% %arena% %memory% %ecs% %world%
 set libs=C:\Users\zachm\OneDrive\Desktop\C-Game-Test\lib\SDL2main.lib C:\Users\zachm\OneDrive\Desktop\C-Game-Test\lib\SDL2.lib C:\Users\zachm\OneDrive\Desktop\C-Game-Test\lib\SDL2_mixer.lib
 
 CL /Zi /I C:\Users\zachm\OneDrive\Desktop\C-Game-Test\include %files% /link %libs% /OUT:mygame.exe
\ No newline at end of file
@@ -0,0 +1,8 @@
+#version 330 core
+out vec4 o_color;
+
+in vec4 v_color;
+
+void main() {
+	o_color = v_color;
+}
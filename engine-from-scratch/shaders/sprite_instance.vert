@@ -0,0 +1,25 @@
+#version 330 core
+layout (location = 0) in vec2 a_position;
+layout (location = 1) in vec2 a_size;
+layout (location = 2) in vec4 a_uvs;
+layout (location = 3) in vec4 a_color;
+layout (location = 4) in uvec2 a_layer_flags;
+
+out vec4 v_color;
+out vec2 v_uvs;
+flat out float v_texture_layer;
+
+uniform mat4 projection;
+
+void main() {
+	// Triangle strip corners (0, 0), (1, 0), (0, 1), (1, 1).
+	vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1);
+	// Flipped sprites read u from right to left.
+	float flip = float(a_layer_flags.y & 1u);
+	vec2 uv_corner = vec2(abs(corner.x - flip), corner.y);
+
+	v_color = a_color;
+	v_uvs = mix(a_uvs.xy, a_uvs.zw, uv_corner);
+	v_texture_layer = float(a_layer_flags.x);
+	gl_Position = projection * vec4(a_position + (corner - 0.5) * a_size, 0.0, 1.0);
+}
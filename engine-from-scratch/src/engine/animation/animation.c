@@ -2,14 +2,26 @@
 
 #include <assert.h>
 #include "../util.h"
-#include "../array_list/array_list.h"
+#include "../array_list/array.h"
+#include "../array_list/sparse_set.h"
 
-static Array_List *animation_def_storage;
-static Array_List *animation_storage;
+DEFINE_ARRAY(Animation_Def)
+DEFINE_SPARSE_SET(Animation)
+
+Animation_Components animation_components;
+static Array_Animation_Def animation_def_storage;
+// Keyed by animation id, only live animations are in the dense array.
+static Sparse_Set_Animation animation_storage;
+//destroyed ids, reused before next_animation_id grows
+static Array_usize free_animation_ids;
+static usize next_animation_id;
 
 void animation_init(void) {
-    animation_def_storage = array_list_create(sizeof(Animation_Def),0);
-    animation_storage = array_list_create(sizeof(Animation),0);
+    animation_components.animation = ecs_component_register(sizeof(Animation));
+    array_Animation_Def_init(&animation_def_storage,0,MEMORY_TAG_RENDER);
+    sparse_set_Animation_init(&animation_storage,MEMORY_TAG_RENDER);
+    array_usize_init(&free_animation_ids,0,MEMORY_TAG_RENDER);
+    next_animation_id = 0;
 }
 
 usize animation_def_create(Sprite_Sheet *sprite_sheet,f32 durations, u8 rows, u8 *columns, u8 frame_count) {
@@ -25,74 +37,98 @@ usize animation_def_create(Sprite_Sheet *sprite_sheet,f32 durations, u8 rows, u8
             .duration = durations,
         };
     }
-    return array_list_append(animation_def_storage,&def);
+    return array_Animation_Def_push(&animation_def_storage,def);
 }
 
 usize animation_create(usize animation_def_id, bool does_loop) {
-    usize id = animation_storage->len;
-    Animation_Def *adef = array_list_get(animation_def_storage, animation_def_id);
-    if(adef == NULL) {
+    if(animation_def_id >= animation_def_storage.len) {
         ERROR_EXIT("Animation definition with id: %zu not found", animation_def_id);
     }
 
-    //try to find free slot first
-    for(usize i = 0; i < animation_storage->len;++i) {
-        Animation *animation = array_list_get(animation_storage,i);
-        if(!animation->is_active) {
-            id = i;
-            break;
-        }   
-    }
-
-    if(id == animation_storage->len) {
-        array_list_append(animation_storage,&(Animation){0});
-    }
-
-    Animation *animation = array_list_get(animation_storage,id);
+    usize id = free_animation_ids.len > 0 ? free_animation_ids.items[--free_animation_ids.len] : next_animation_id++;
 
     //other fields default to 0 when using field dot syntax
-    *animation = (Animation) {
+    sparse_set_Animation_add(&animation_storage,id,(Animation) {
         .animation_definition_id = animation_def_id,
         .does_loop = does_loop,
         .is_active = true,
-    };
+    });
 
     return id;
 }
 
 void animation_destroy(usize id) {
-     Animation *animation = array_list_get(animation_storage,id);
-     animation->is_active = false;
+    if(!sparse_set_Animation_has(&animation_storage,id)) {
+        return;
+    }
+    sparse_set_Animation_remove(&animation_storage,id);
+    if(array_usize_push(&free_animation_ids,id) == (usize)-1) {
+        ERROR_EXIT("Could not grow free animation ids\n");
+    }
 }
 
 Animation* animation_get(usize id) {
-    return array_list_get(animation_storage,id);
+    if(!sparse_set_Animation_has(&animation_storage,id)) {
+        ERROR_RETURN(NULL,"Animation %zu not found\n",id);
+    }
+    return sparse_set_Animation_get(&animation_storage,id);
 }
 
-void animation_update(f32 dt) {
-    for(usize i = 0;i < animation_storage->len;++i) {
-         Animation *animation = array_list_get(animation_storage,i);
-         Animation_Def *adef =  array_list_get(animation_def_storage,animation->animation_definition_id);
-         animation->current_frame_time -= dt;
-       
-         if(animation->current_frame_time <= 0) {
-            animation->current_frame_index +=1 ;
-
-            //loop or stay on last frame
-            if(animation->current_frame_index == adef->frame_count) {
-                if(animation->does_loop) {
-                    animation->current_frame_index = 0;
-                } else {
-                    animation->current_frame_index -= 1;
-                }
+static void animation_step(Animation *animation,f32 dt) {
+    Animation_Def *adef =  array_Animation_Def_get(&animation_def_storage,animation->animation_definition_id);
+    animation->current_frame_time -= dt;
+
+    if(animation->current_frame_time <= 0) {
+        animation->current_frame_index +=1 ;
+
+        //loop or stay on last frame
+        if(animation->current_frame_index == adef->frame_count) {
+            if(animation->does_loop) {
+                animation->current_frame_index = 0;
+            } else {
+                animation->current_frame_index -= 1;
             }
-            animation->current_frame_time = adef->frames[animation->current_frame_index].duration;
         }
+        animation->current_frame_time = adef->frames[animation->current_frame_index].duration;
     }
 }
 
-void animation_render(Animation *animation,vec2 pos,vec4 color,u32 texture_slots[8]) {
-    Animation_Def *adef = array_list_get(animation_def_storage,animation->animation_definition_id);
+void animation_update(f32 dt) {
+    Ecs_Query query = ecs_query(ECS_MASK(animation_components.animation),0);
+    Ecs_View view;
+
+    while(ecs_query_next(&query,&view)) {
+        Animation *animations = ecs_view_column(&view,animation_components.animation);
+        for(usize i = 0;i < view.count;++i) {
+            animation_step(&animations[i],dt);
+        }
+    }
+}
+
+void animation_render(Animation *animation,vec2 pos,vec4 color) {
+    Animation_Def *adef = array_Animation_Def_get(&animation_def_storage,animation->animation_definition_id);
     Animation_Frame *aframe = &adef->frames[animation->current_frame_index];
-    render_sprite_sheet_frame(adef->sprite_sheet,aframe->row,aframe->column,pos,animation->is_flipped,color,texture_slots);
-}
\ No newline at end of file
+    render_sprite_sheet_frame(adef->sprite_sheet,aframe->row,aframe->column,pos,animation->is_flipped,color);
+}
+
+bool animation_snapshot_check_chunk(Ecs_Mask mask, Ecs_View *view) {
+    if(!(mask & ECS_MASK(animation_components.animation))) {
+        return true;
+    }
+
+    //update and render index the definition's frames with the saved frame index
+    Animation *animations = ecs_view_column(view,animation_components.animation);
+    for(usize i = 0;i<view->count;++i) {
+        if(animations[i].animation_definition_id >= animation_def_storage.len) {
+            ERROR_RETURN(false,"Animation snapshot uses an unknown definition\n");
+        }
+        if(animations[i].current_frame_index >= animation_def_storage.items[animations[i].animation_definition_id].frame_count) {
+            ERROR_RETURN(false,"Animation snapshot frame index is past the definition's frames\n");
+        }
+        if(!blob_bool_is_valid(&animations[i].does_loop) || !blob_bool_is_valid(&animations[i].is_active) || !blob_bool_is_valid(&animations[i].is_flipped)) {
+            ERROR_RETURN(false,"Animation snapshot has a bad flag\n");
+        }
+    }
+
+    return true;
+}
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "../render/render.h"
+#include "../ecs/ecs.h"
 #include <stdbool.h>
 
 #define MAX_FRAMES 16
@@ -26,10 +27,24 @@ typedef struct animation {
     bool is_flipped;
 } Animation;
 
+//the animation component holds the Animation an entity plays, copied from a template
+typedef struct animation_components {
+    u32 animation;
+} Animation_Components;
+
+extern Animation_Components animation_components;
+
+//call after ecs_init, registers the animation component
 void animation_init(void);
 usize animation_def_create(Sprite_Sheet *sprite_sheet,f32 durations, u8 rows, u8 *columns, u8 frame_count);
+//animations made here are templates, entities play their own copy in the animation component
 usize animation_create(usize animation_def_id, bool does_loop);
 void animation_destroy(usize id);
+// NULL if the id is not a live animation.
 Animation* animation_get(usize id);
+//steps every animation component, one query over the ECS chunks
 void animation_update(f32 dt);
-void animation_render(Animation *animation,vec2 pos,vec4 color,u32 texture_slots[8]);
\ No newline at end of file
+void animation_render(Animation *animation,vec2 pos,vec4 color);
+//ecs_snapshot_validate check for saved chunks holding animations, definitions only exist at runtime
+//so the saved definition ids and frame indices are checked against them
+bool animation_snapshot_check_chunk(Ecs_Mask mask, Ecs_View *view);
\ No newline at end of file
@@ -0,0 +1,73 @@
+#include <stdlib.h>
+
+#include "arena.h"
+#include "../util.h"
+
+static Arena frame_arenas[2];
+static u8 frame_index;
+
+void arena_init(Arena *arena, usize capacity, Memory_Tag tag) {
+	*arena = (Arena){0};
+	arena->data = memory_alloc(capacity, tag);
+	if (!arena->data) {
+		ERROR_EXIT("Could not allocate memory for Arena\n");
+	}
+	arena->capacity = capacity;
+}
+
+void *arena_alloc(Arena *arena, usize size, usize alignment) {
+	// Alignment must be a power of two.
+	usize offset = (arena->offset + alignment - 1) & ~(alignment - 1);
+	// Compared against the space left so a huge size cannot wrap past the capacity.
+	if (offset > arena->capacity || size > arena->capacity - offset) {
+		ERROR_RETURN(NULL, "Arena out of memory: %zu of %zu bytes used, %zu requested\n", arena->offset, arena->capacity, size);
+	}
+
+	arena->offset = offset + size;
+	if (arena->offset > arena->high_water) {
+		arena->high_water = arena->offset;
+	}
+
+	return arena->data + offset;
+}
+
+void arena_reset(Arena *arena) {
+	arena->offset = 0;
+}
+
+Arena_Temp arena_temp_begin(Arena *arena) {
+	return (Arena_Temp){ .arena = arena, .offset = arena->offset };
+}
+
+void arena_temp_end(Arena_Temp temp) {
+	temp.arena->offset = temp.offset;
+}
+
+void frame_arena_init(usize capacity) {
+	arena_init(&frame_arenas[0], capacity, MEMORY_TAG_FRAME);
+	arena_init(&frame_arenas[1], capacity, MEMORY_TAG_FRAME);
+	frame_index = 0;
+}
+
+void frame_arena_begin(void) {
+	frame_index ^= 1;
+	arena_reset(&frame_arenas[frame_index]);
+}
+
+void *frame_alloc(usize size, usize alignment) {
+	return arena_alloc(&frame_arenas[frame_index], size, alignment);
+}
+
+Arena *frame_arena_current(void) {
+	return &frame_arenas[frame_index];
+}
+
+Arena *frame_arena_previous(void) {
+	return &frame_arenas[frame_index ^ 1];
+}
+
+usize frame_arena_high_water(void) {
+	usize a = frame_arenas[0].high_water;
+	usize b = frame_arenas[1].high_water;
+	return a > b ? a : b;
+}
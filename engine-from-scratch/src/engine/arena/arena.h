@@ -0,0 +1,46 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "../types.h"
+#include "../memory/memory.h"
+
+#define FRAME_ARENA_CAPACITY (4 * 1024 * 1024)
+
+// MSVC builds without /std:c11 only have __alignof.
+#if defined(_MSC_VER)
+#define ALIGNOF(T) __alignof(T)
+#else
+#define ALIGNOF(T) _Alignof(T)
+#endif
+#define ARENA_PUSH(arena, T, count) (T *)arena_alloc((arena), sizeof(T) * (count), ALIGNOF(T))
+#define FRAME_PUSH(T, count) (T *)frame_alloc(sizeof(T) * (count), ALIGNOF(T))
+
+// Bump allocator, everything is freed at once with arena_reset.
+typedef struct arena {
+	u8 *data;
+	usize capacity;
+	usize offset;
+	usize high_water;
+} Arena;
+
+// Saved offset, arena_temp_end frees everything allocated since arena_temp_begin.
+typedef struct arena_temp {
+	Arena *arena;
+	usize offset;
+} Arena_Temp;
+
+void arena_init(Arena *arena, usize capacity, Memory_Tag tag);
+void *arena_alloc(Arena *arena, usize size, usize alignment);
+void arena_reset(Arena *arena);
+Arena_Temp arena_temp_begin(Arena *arena);
+void arena_temp_end(Arena_Temp temp);
+
+// Two arenas that swap every frame, so data allocated last frame stays valid for one more frame.
+void frame_arena_init(usize capacity);
+void frame_arena_begin(void);
+void *frame_alloc(usize size, usize alignment);
+Arena *frame_arena_current(void);
+Arena *frame_arena_previous(void);
+usize frame_arena_high_water(void);
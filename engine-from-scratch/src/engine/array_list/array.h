@@ -0,0 +1,87 @@
+#pragma once
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../types.h"
+#include "../util.h"
+#include "../memory/memory.h"
+
+// Typed dynamic array. DEFINE_ARRAY(Body) generates:
+//   Array_Body, array_Body_init, array_Body_push, array_Body_get, array_Body_try_get, array_Body_remove, array_Body_assign
+// Element size is known at compile time and get only checks bounds in debug builds, so it compiles
+// down to a plain index in hot loops. Use try_get for indices from outside the module.
+#define DEFINE_ARRAY(T) \
+	typedef struct array_##T { \
+		usize len; \
+		usize capacity; \
+		T *items; \
+		Memory_Tag tag; \
+	} Array_##T; \
+	\
+	static inline void array_##T##_init(Array_##T *array, usize initial_capacity, Memory_Tag tag) { \
+		array->len = 0; \
+		array->capacity = initial_capacity; \
+		array->items = NULL; \
+		array->tag = tag; \
+		if (initial_capacity > 0) { \
+			array->items = memory_alloc(sizeof(T) * initial_capacity, tag); \
+			if (!array->items) { \
+				ERROR_EXIT("Could not allocate memory for Array_" #T "\n"); \
+			} \
+		} \
+	} \
+	\
+	static inline usize array_##T##_push(Array_##T *array, T item) { \
+		if (array->len == array->capacity) { \
+			usize capacity = array->capacity > 0 ? array->capacity * 2 : 1; \
+			T *items = memory_realloc(array->items, sizeof(T) * capacity, array->tag); \
+			if (!items) { \
+				ERROR_RETURN(-1, "Could not allocate memory for Array_" #T "\n"); \
+			} \
+			array->items = items; \
+			array->capacity = capacity; \
+		} \
+		array->items[array->len] = item; \
+		return array->len++; \
+	} \
+	\
+	static inline T *array_##T##_get(Array_##T *array, usize index) { \
+		assert(index < array->len); \
+		return &array->items[index]; \
+	} \
+	\
+	/* Checked in every build, NULL for a bad index like array_list_get. */ \
+	static inline T *array_##T##_try_get(Array_##T *array, usize index) { \
+		if (index >= array->len) { \
+			ERROR_RETURN(NULL, "Index out of bounds\n"); \
+		} \
+		return &array->items[index]; \
+	} \
+	\
+	/* Swaps the last item into index, same as array_list_remove. */ \
+	static inline void array_##T##_remove(Array_##T *array, usize index) { \
+		assert(index < array->len); \
+		array->items[index] = array->items[--array->len]; \
+	} \
+	\
+	/* Replaces the contents with a copy of count items. */ \
+	static inline bool array_##T##_assign(Array_##T *array, const T *items, usize count) { \
+		if (count > array->capacity) { \
+			T *new_items = memory_realloc(array->items, sizeof(T) * count, array->tag); \
+			if (!new_items) { \
+				ERROR_RETURN(false, "Could not allocate memory for Array_" #T "\n"); \
+			} \
+			array->items = new_items; \
+			array->capacity = count; \
+		} \
+		if (count > 0) { \
+			memcpy(array->items, items, sizeof(T) * count); \
+		} \
+		array->len = count; \
+		return true; \
+	}
+
+DEFINE_ARRAY(usize)
@@ -4,29 +4,47 @@
 #include "array_list.h"
 #include "../util.h"
 
-Array_List* array_list_create(usize item_size, usize initial_capacity) {
-	Array_List* list = malloc(sizeof(Array_List));
+Array_List* array_list_create(usize item_size, usize initial_capacity, Memory_Tag tag) {
+	Array_List* list = memory_alloc(sizeof(Array_List), tag);
 	if (!list) {
 		ERROR_RETURN(NULL,"Could not allocate memory for Array_List\n");
 	}
 	list->item_size = item_size;
 	list->capacity = initial_capacity;
 	list->len = 0;
-	list->items = malloc(item_size * initial_capacity);
+	list->tag = tag;
+	list->items = memory_alloc(item_size * initial_capacity, tag);
 	if (!list->items) {
 		ERROR_RETURN(NULL, "Could not allocate memory for Array_List\n");
 	}
 	return list;
 }
 
+u8 array_list_reserve(Array_List* list, usize capacity) {
+	if (capacity <= list->capacity) {
+		return 0;
+	}
+
+	usize new_capacity = list->capacity > 0 ? list->capacity : 1;
+	while (new_capacity < capacity) {
+		new_capacity *= 2;
+	}
+
+	void* items = memory_realloc(list->items, list->item_size * new_capacity, list->tag);
+	if (!items) {
+		ERROR_RETURN(1, "Could not allocate memory for Array_List\n");
+	}
+	list->items = items;
+	list->capacity = new_capacity;
+
+	return 0;
+}
+
 usize array_list_append(Array_List* list, void* item) {
 	if(list->len == list->capacity) {
-		list->capacity = list->capacity > 0 ? list->capacity * 2 : 1;
-		void* items = realloc(list->items, list->item_size * list->capacity);
-		if (!items) {
-			ERROR_RETURN(-1, "Could not allocate memory for Array_List\n");
+		if (array_list_reserve(list, list->len + 1) != 0) {
+			return -1;
 		}
-		list->items = items;
 	}
 
 	usize index = list->len++;
@@ -36,6 +54,28 @@ usize array_list_append(Array_List* list, void* item) {
 	return index;
 }
 
+usize array_list_append_n(Array_List* list, void* items, usize count) {
+	void* slots = array_list_extend_uninit(list, count);
+	if (!slots) {
+		return -1;
+	}
+
+	memcpy(slots, items, list->item_size * count);
+
+	return list->len - count;
+}
+
+void* array_list_extend_uninit(Array_List* list, usize count) {
+	if (array_list_reserve(list, list->len + count) != 0) {
+		return NULL;
+	}
+
+	void* slots = (u8*)list->items + list->len * list->item_size;
+	list->len += count;
+
+	return slots;
+}
+
 void* array_list_get(Array_List* list, usize index) {
 	if (index >= list->len) {
 		ERROR_RETURN(NULL, "Index out of bounds\n");
@@ -1,15 +1,23 @@
 #pragma once
 
 #include "../types.h"
+#include "../memory/memory.h"
 
 typedef struct array_list {
 	usize len;
 	usize capacity;
 	usize item_size;
 	void* items;
+	Memory_Tag tag;
 }Array_List;
 
-Array_List* array_list_create(usize item_size, usize initial_capacity);
+Array_List* array_list_create(usize item_size, usize initial_capacity, Memory_Tag tag);
 usize array_list_append(Array_List* list, void* item);
+// Grows capacity to at least the given number of items. Returns 0 on success.
+u8 array_list_reserve(Array_List* list, usize capacity);
+// Copies count items in one go, returns the index of the first one.
+usize array_list_append_n(Array_List* list, void* items, usize count);
+// Adds count items without initializing them, returns a pointer to the first one to write into.
+void* array_list_extend_uninit(Array_List* list, usize count);
 void* array_list_get(Array_List* list, usize index);
 u8 array_list_remove(Array_List* list, usize index);
\ No newline at end of file
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "../types.h"
+#include "../util.h"
+#include "../memory/memory.h"
+
+#define SPARSE_SET_EMPTY ((usize)-1)
+
+// Sparse set keyed by id. DEFINE_SPARSE_SET(Animation) generates:
+//   Sparse_Set_Animation, sparse_set_Animation_init, _add, _remove, _has, _get, _clear
+// sparse[id] is the index into the packed dense/dense_ids arrays, or SPARSE_SET_EMPTY.
+// Iterate live items with: for (usize i = 0; i < set.len; ++i) set.dense[i], set.dense_ids[i]
+// Remove swaps the last item into the hole, so pointers from _get are only valid until the next remove.
+#define DEFINE_SPARSE_SET(T) \
+	typedef struct sparse_set_##T { \
+		usize *sparse; \
+		usize sparse_len; \
+		usize *dense_ids; \
+		T *dense; \
+		usize len; \
+		usize capacity; \
+		Memory_Tag tag; \
+	} Sparse_Set_##T; \
+	\
+	static inline void sparse_set_##T##_init(Sparse_Set_##T *set, Memory_Tag tag) { \
+		*set = (Sparse_Set_##T){ .tag = tag }; \
+	} \
+	\
+	static inline bool sparse_set_##T##_has(Sparse_Set_##T *set, usize id) { \
+		return id < set->sparse_len && set->sparse[id] != SPARSE_SET_EMPTY; \
+	} \
+	\
+	static inline T *sparse_set_##T##_get(Sparse_Set_##T *set, usize id) { \
+		assert(sparse_set_##T##_has(set, id)); \
+		return &set->dense[set->sparse[id]]; \
+	} \
+	\
+	/* Inserts or overwrites the item for id. */ \
+	static inline T *sparse_set_##T##_add(Sparse_Set_##T *set, usize id, T item) { \
+		if (sparse_set_##T##_has(set, id)) { \
+			T *existing = &set->dense[set->sparse[id]]; \
+			*existing = item; \
+			return existing; \
+		} \
+		if (id >= set->sparse_len) { \
+			usize sparse_len = set->sparse_len > 0 ? set->sparse_len : 1; \
+			while (sparse_len <= id) { \
+				sparse_len *= 2; \
+			} \
+			usize *sparse = memory_realloc(set->sparse, sizeof(usize) * sparse_len, set->tag); \
+			if (!sparse) { \
+				ERROR_EXIT("Could not allocate memory for Sparse_Set_" #T "\n"); \
+			} \
+			for (usize i = set->sparse_len; i < sparse_len; ++i) { \
+				sparse[i] = SPARSE_SET_EMPTY; \
+			} \
+			set->sparse = sparse; \
+			set->sparse_len = sparse_len; \
+		} \
+		if (set->len == set->capacity) { \
+			usize capacity = set->capacity > 0 ? set->capacity * 2 : 1; \
+			T *dense = memory_realloc(set->dense, sizeof(T) * capacity, set->tag); \
+			usize *dense_ids = memory_realloc(set->dense_ids, sizeof(usize) * capacity, set->tag); \
+			if (!dense || !dense_ids) { \
+				ERROR_EXIT("Could not allocate memory for Sparse_Set_" #T "\n"); \
+			} \
+			set->dense = dense; \
+			set->dense_ids = dense_ids; \
+			set->capacity = capacity; \
+		} \
+		usize index = set->len++; \
+		set->dense[index] = item; \
+		set->dense_ids[index] = id; \
+		set->sparse[id] = index; \
+		return &set->dense[index]; \
+	} \
+	\
+	static inline void sparse_set_##T##_remove(Sparse_Set_##T *set, usize id) { \
+		if (!sparse_set_##T##_has(set, id)) { \
+			return; \
+		} \
+		usize index = set->sparse[id]; \
+		usize last = --set->len; \
+		set->dense[index] = set->dense[last]; \
+		set->dense_ids[index] = set->dense_ids[last]; \
+		set->sparse[set->dense_ids[index]] = index; \
+		set->sparse[id] = SPARSE_SET_EMPTY; \
+	} \
+	\
+	static inline void sparse_set_##T##_clear(Sparse_Set_##T *set) { \
+		for (usize i = 0; i < set->len; ++i) { \
+			set->sparse[set->dense_ids[i]] = SPARSE_SET_EMPTY; \
+		} \
+		set->len = 0; \
+	}
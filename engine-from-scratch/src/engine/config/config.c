@@ -2,6 +2,7 @@
 #include "../global.h"
 #include "../io/io.h"
 #include "../util.h"
+#include "../memory/memory.h"
 #include <string.h>
 
 #include <SDL2/SDL.h>
@@ -64,7 +65,7 @@ static int config_load(void) {
 	}
 	load_controls(file_config.data);
 
-	free(file_config.data);
+	memory_free(file_config.data);
 
 	return 0;
 }
@@ -0,0 +1,581 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "ecs.h"
+#include "../util.h"
+#include "../memory/memory.h"
+#include "../array_list/array.h"
+
+typedef struct ecs_chunk {
+	usize count;
+	// entity ids first, then one column of ECS_CHUNK_CAPACITY items per component.
+	u8 *data;
+} Ecs_Chunk;
+
+typedef struct ecs_archetype {
+	Ecs_Mask mask;
+	usize column_offsets[ECS_MAX_COMPONENTS];
+	usize chunk_size;
+	// Only the last used chunk can be partially filled, chunks past chunk_count are kept for reuse.
+	usize chunk_count;
+	usize count;
+	Ecs_Chunk *chunks;
+	usize chunk_capacity;
+} Ecs_Archetype;
+
+typedef struct ecs_location {
+	usize archetype;
+	usize chunk;
+	usize row;
+	bool is_alive;
+} Ecs_Location;
+
+typedef struct ecs_archetype_snapshot {
+	Ecs_Mask mask;
+	u64 chunk_size;
+	u64 count;
+	u64 chunk_count;
+	// chunk_count chunks of chunk_size bytes, back to back.
+	u64 chunks;
+} Ecs_Archetype_Snapshot;
+
+typedef struct ecs_snapshot {
+	u64 component_count;
+	u64 component_sizes;
+	u64 archetype_count;
+	u64 archetypes;
+	u64 location_count;
+	u64 locations;
+	u64 free_id_count;
+	u64 free_ids;
+} Ecs_Snapshot;
+
+DEFINE_ARRAY(Ecs_Archetype)
+DEFINE_ARRAY(Ecs_Location)
+
+static usize component_sizes[ECS_MAX_COMPONENTS];
+static u32 component_count;
+static Array_Ecs_Archetype archetypes;
+static Array_Ecs_Location locations;
+static Array_usize free_ids;
+
+void ecs_init(void) {
+	component_count = 0;
+	array_Ecs_Archetype_init(&archetypes, 0, MEMORY_TAG_ENTITY);
+	array_Ecs_Location_init(&locations, 0, MEMORY_TAG_ENTITY);
+	array_usize_init(&free_ids, 0, MEMORY_TAG_ENTITY);
+	ecs_component_register(0);
+}
+
+static Ecs_Mask skip_disabled(Ecs_Mask all, Ecs_Mask none) {
+	return (all & ECS_MASK(ECS_DISABLED)) ? none : none | ECS_MASK(ECS_DISABLED);
+}
+
+u32 ecs_component_register(usize size) {
+	if (component_count == ECS_MAX_COMPONENTS) {
+		ERROR_EXIT("Too many ECS components, max is %d\n", ECS_MAX_COMPONENTS);
+	}
+
+	component_sizes[component_count] = size;
+	return component_count++;
+}
+
+// Columns are 16 byte aligned inside the chunk. Returns the chunk size.
+static usize archetype_layout(Ecs_Mask mask, usize column_offsets[ECS_MAX_COMPONENTS]) {
+	usize offset = sizeof(usize) * ECS_CHUNK_CAPACITY;
+	for (u32 i = 0; i < component_count; ++i) {
+		if (mask & ECS_MASK(i)) {
+			offset = (offset + 15) & ~(usize)15;
+			column_offsets[i] = offset;
+			offset += component_sizes[i] * ECS_CHUNK_CAPACITY;
+		}
+	}
+	// Rounded up so chunks stored back to back in snapshots stay 16 byte aligned.
+	return (offset + 15) & ~(usize)15;
+}
+
+static usize archetype_find_or_create(Ecs_Mask mask) {
+	for (usize i = 0; i < archetypes.len; ++i) {
+		if (archetypes.items[i].mask == mask) {
+			return i;
+		}
+	}
+
+	Ecs_Archetype archetype = { .mask = mask };
+	archetype.chunk_size = archetype_layout(mask, archetype.column_offsets);
+
+	return array_Ecs_Archetype_push(&archetypes, archetype);
+}
+
+static Ecs_Chunk *archetype_add_chunk(Ecs_Archetype *archetype) {
+	if (archetype->chunk_count == archetype->chunk_capacity) {
+		usize capacity = archetype->chunk_capacity > 0 ? archetype->chunk_capacity * 2 : 1;
+		Ecs_Chunk *chunks = memory_realloc(archetype->chunks, sizeof(Ecs_Chunk) * capacity, MEMORY_TAG_ENTITY);
+		if (!chunks) {
+			ERROR_EXIT("Could not allocate memory for ECS chunks\n");
+		}
+		for (usize i = archetype->chunk_capacity; i < capacity; ++i) {
+			chunks[i] = (Ecs_Chunk){0};
+		}
+		archetype->chunks = chunks;
+		archetype->chunk_capacity = capacity;
+	}
+
+	Ecs_Chunk *chunk = &archetype->chunks[archetype->chunk_count];
+	if (!chunk->data) {
+		chunk->data = memory_alloc(archetype->chunk_size, MEMORY_TAG_ENTITY);
+		if (!chunk->data) {
+			ERROR_EXIT("Could not allocate memory for ECS chunk\n");
+		}
+	}
+	chunk->count = 0;
+	++archetype->chunk_count;
+
+	return chunk;
+}
+
+static Ecs_Chunk *archetype_push_row(Ecs_Archetype *archetype, usize id, usize *chunk_index, usize *row) {
+	if (archetype->count == archetype->chunk_count * ECS_CHUNK_CAPACITY) {
+		archetype_add_chunk(archetype);
+	}
+
+	*chunk_index = archetype->chunk_count - 1;
+	Ecs_Chunk *chunk = &archetype->chunks[*chunk_index];
+	*row = chunk->count++;
+	++archetype->count;
+
+	((usize *)chunk->data)[*row] = id;
+	for (u32 i = 0; i < component_count; ++i) {
+		if (archetype->mask & ECS_MASK(i)) {
+			memset(chunk->data + archetype->column_offsets[i] + component_sizes[i] * *row, 0, component_sizes[i]);
+		}
+	}
+
+	return chunk;
+}
+
+// Fills the hole with the archetype's last row so every chunk stays packed.
+static void archetype_remove_row(Ecs_Archetype *archetype, usize chunk_index, usize row) {
+	Ecs_Chunk *last_chunk = &archetype->chunks[archetype->chunk_count - 1];
+	usize last_row = last_chunk->count - 1;
+	Ecs_Chunk *chunk = &archetype->chunks[chunk_index];
+
+	if (chunk != last_chunk || row != last_row) {
+		usize moved_id = ((usize *)last_chunk->data)[last_row];
+		((usize *)chunk->data)[row] = moved_id;
+
+		for (u32 i = 0; i < component_count; ++i) {
+			if (archetype->mask & ECS_MASK(i)) {
+				usize size = component_sizes[i];
+				memcpy(chunk->data + archetype->column_offsets[i] + size * row, last_chunk->data + archetype->column_offsets[i] + size * last_row, size);
+			}
+		}
+
+		locations.items[moved_id].chunk = chunk_index;
+		locations.items[moved_id].row = row;
+	}
+
+	--last_chunk->count;
+	--archetype->count;
+	if (last_chunk->count == 0) {
+		--archetype->chunk_count;
+	}
+}
+
+static usize create_in_archetype(usize archetype_index) {
+	usize id;
+	if (free_ids.len > 0) {
+		id = free_ids.items[--free_ids.len];
+	} else {
+		id = array_Ecs_Location_push(&locations, (Ecs_Location){0});
+	}
+
+	Ecs_Location *location = &locations.items[id];
+	location->archetype = archetype_index;
+	archetype_push_row(&archetypes.items[archetype_index], id, &location->chunk, &location->row);
+	location->is_alive = true;
+
+	return id;
+}
+
+usize ecs_create(Ecs_Mask mask) {
+	return create_in_archetype(archetype_find_or_create(mask));
+}
+
+void ecs_create_batch(Ecs_Mask mask, usize count, usize *ids) {
+	usize archetype_index = archetype_find_or_create(mask);
+	for (usize i = 0; i < count; ++i) {
+		ids[i] = create_in_archetype(archetype_index);
+	}
+}
+
+bool ecs_is_alive(usize id) {
+	return id < locations.len && locations.items[id].is_alive;
+}
+
+void ecs_destroy(usize id) {
+	if (!ecs_is_alive(id)) {
+		return;
+	}
+
+	Ecs_Location *location = &locations.items[id];
+	archetype_remove_row(&archetypes.items[location->archetype], location->chunk, location->row);
+	location->is_alive = false;
+	array_usize_push(&free_ids, id);
+}
+
+bool ecs_has(usize id, u32 component) {
+	return ecs_is_alive(id) && (archetypes.items[locations.items[id].archetype].mask & ECS_MASK(component));
+}
+
+void *ecs_get(usize id, u32 component) {
+	if (!ecs_has(id, component)) {
+		return NULL;
+	}
+
+	Ecs_Location *location = &locations.items[id];
+	Ecs_Archetype *archetype = &archetypes.items[location->archetype];
+	return archetype->chunks[location->chunk].data + archetype->column_offsets[component] + component_sizes[component] * location->row;
+}
+
+static void ecs_move(usize id, Ecs_Mask mask) {
+	Ecs_Location *location = &locations.items[id];
+	usize old_archetype_index = location->archetype;
+	usize new_archetype_index = archetype_find_or_create(mask);
+
+	// archetype_find_or_create can grow the archetype array, so index it afterwards.
+	Ecs_Archetype *old_archetype = &archetypes.items[old_archetype_index];
+	Ecs_Archetype *new_archetype = &archetypes.items[new_archetype_index];
+
+	usize chunk_index, row;
+	Ecs_Chunk *new_chunk = archetype_push_row(new_archetype, id, &chunk_index, &row);
+	Ecs_Chunk *old_chunk = &old_archetype->chunks[location->chunk];
+
+	for (u32 i = 0; i < component_count; ++i) {
+		if (old_archetype->mask & new_archetype->mask & ECS_MASK(i)) {
+			usize size = component_sizes[i];
+			memcpy(new_chunk->data + new_archetype->column_offsets[i] + size * row, old_chunk->data + old_archetype->column_offsets[i] + size * location->row, size);
+		}
+	}
+
+	archetype_remove_row(old_archetype, location->chunk, location->row);
+
+	location->archetype = new_archetype_index;
+	location->chunk = chunk_index;
+	location->row = row;
+}
+
+void ecs_add(usize id, u32 component) {
+	if (!ecs_is_alive(id) || ecs_has(id, component)) {
+		return;
+	}
+
+	ecs_move(id, archetypes.items[locations.items[id].archetype].mask | ECS_MASK(component));
+}
+
+void ecs_remove(usize id, u32 component) {
+	if (!ecs_has(id, component)) {
+		return;
+	}
+
+	ecs_move(id, archetypes.items[locations.items[id].archetype].mask & ~ECS_MASK(component));
+}
+
+usize ecs_count(Ecs_Mask all) {
+	Ecs_Mask none = skip_disabled(all, 0);
+	usize count = 0;
+	for (usize i = 0; i < archetypes.len; ++i) {
+		if ((archetypes.items[i].mask & all) == all && (archetypes.items[i].mask & none) == 0) {
+			count += archetypes.items[i].count;
+		}
+	}
+
+	return count;
+}
+
+void ecs_clear(void) {
+	for (usize i = 0; i < archetypes.len; ++i) {
+		archetypes.items[i].count = 0;
+		archetypes.items[i].chunk_count = 0;
+	}
+
+	locations.len = 0;
+	free_ids.len = 0;
+}
+
+Ecs_Query ecs_query(Ecs_Mask all, Ecs_Mask none) {
+	return (Ecs_Query){ .all = all, .none = skip_disabled(all, none) };
+}
+
+bool ecs_query_next(Ecs_Query *query, Ecs_View *view) {
+	while (query->archetype < archetypes.len) {
+		Ecs_Archetype *archetype = &archetypes.items[query->archetype];
+
+		bool is_match = (archetype->mask & query->all) == query->all && (archetype->mask & query->none) == 0;
+		if (is_match && query->chunk < archetype->chunk_count) {
+			Ecs_Chunk *chunk = &archetype->chunks[query->chunk++];
+			*view = (Ecs_View){
+				.count = chunk->count,
+				.entity_ids = (usize *)chunk->data,
+				.data = chunk->data,
+				.column_offsets = archetype->column_offsets,
+			};
+			return true;
+		}
+
+		++query->archetype;
+		query->chunk = 0;
+	}
+
+	return false;
+}
+
+u64 ecs_snapshot_write(Blob_Writer *writer) {
+	u64 offset = blob_reserve(writer, sizeof(Ecs_Snapshot));
+	Ecs_Snapshot snapshot = {
+		.component_count = component_count,
+		.component_sizes = blob_write(writer, component_sizes, sizeof(usize) * component_count),
+		.archetype_count = archetypes.len,
+		.archetypes = blob_reserve(writer, sizeof(Ecs_Archetype_Snapshot) * archetypes.len),
+		.location_count = locations.len,
+		.locations = blob_write(writer, locations.items, sizeof(Ecs_Location) * locations.len),
+		.free_id_count = free_ids.len,
+		.free_ids = blob_write(writer, free_ids.items, sizeof(usize) * free_ids.len),
+	};
+
+	Ecs_Archetype_Snapshot *archetype_snapshots = blob_ptr(writer, snapshot.archetypes);
+	for (usize i = 0; i < archetypes.len; ++i) {
+		Ecs_Archetype *archetype = &archetypes.items[i];
+		Ecs_Archetype_Snapshot archetype_snapshot = {
+			.mask = archetype->mask,
+			.chunk_size = archetype->chunk_size,
+			.count = archetype->count,
+			.chunk_count = archetype->chunk_count,
+			.chunks = blob_reserve(writer, archetype->chunk_size * archetype->chunk_count),
+		};
+
+		u8 *chunks = blob_ptr(writer, archetype_snapshot.chunks);
+		if (chunks) {
+			for (usize j = 0; j < archetype->chunk_count; ++j) {
+				memcpy(chunks + archetype->chunk_size * j, archetype->chunks[j].data, archetype->chunk_size);
+			}
+			archetype_snapshots[i] = archetype_snapshot;
+		}
+	}
+
+	if (writer->data) {
+		memcpy(blob_ptr(writer, offset), &snapshot, sizeof(Ecs_Snapshot));
+	}
+
+	return offset;
+}
+
+// Sections of a snapshot header, NULL for any that does not fit in the blob.
+typedef struct ecs_snapshot_sections {
+	const usize *sizes;
+	const Ecs_Archetype_Snapshot *archetypes;
+	const Ecs_Location *locations;
+	const usize *free_ids;
+} Ecs_Snapshot_Sections;
+
+static Ecs_Snapshot_Sections ecs_snapshot_sections(const u8 *data, usize len, const Ecs_Snapshot *snapshot) {
+	return (Ecs_Snapshot_Sections){
+		.sizes = blob_array(data, len, snapshot->component_sizes, snapshot->component_count, sizeof(usize)),
+		.archetypes = blob_array(data, len, snapshot->archetypes, snapshot->archetype_count, sizeof(Ecs_Archetype_Snapshot)),
+		.locations = blob_array(data, len, snapshot->locations, snapshot->location_count, sizeof(Ecs_Location)),
+		.free_ids = blob_array(data, len, snapshot->free_ids, snapshot->free_id_count, sizeof(usize)),
+	};
+}
+
+static int compare_mask(const void *a, const void *b) {
+	Ecs_Mask x = *(const Ecs_Mask *)a;
+	Ecs_Mask y = *(const Ecs_Mask *)b;
+	return (x > y) - (x < y);
+}
+
+// Archetypes are remapped by mask on load, two with the same mask would share one live archetype.
+static bool ecs_snapshot_masks_are_unique(const Ecs_Archetype_Snapshot *archetype_snapshots, u64 archetype_count) {
+	Ecs_Mask *masks = memory_alloc(sizeof(Ecs_Mask) * (archetype_count + 1), MEMORY_TAG_ENTITY);
+	if (!masks) {
+		ERROR_EXIT("Could not allocate memory for ECS snapshot validation\n");
+	}
+	for (u64 i = 0; i < archetype_count; ++i) {
+		masks[i] = archetype_snapshots[i].mask;
+	}
+	qsort(masks, archetype_count, sizeof(Ecs_Mask), compare_mask);
+
+	bool is_unique = true;
+	for (u64 i = 1; i < archetype_count && is_unique; ++i) {
+		is_unique = masks[i] != masks[i - 1];
+	}
+	memory_free(masks);
+	return is_unique;
+}
+
+bool ecs_snapshot_validate(const u8 *data, usize len, u64 offset, Ecs_Snapshot_Chunk_Check check, void *context) {
+	const Ecs_Snapshot *snapshot = blob_at(data, len, offset, sizeof(Ecs_Snapshot));
+	if (!snapshot) {
+		ERROR_RETURN(false, "ECS snapshot header out of range\n");
+	}
+
+	Ecs_Snapshot_Sections sections = ecs_snapshot_sections(data, len, snapshot);
+	if (!sections.sizes || !sections.archetypes || !sections.locations || !sections.free_ids) {
+		ERROR_RETURN(false, "ECS snapshot section out of range\n");
+	}
+
+	if (snapshot->component_count != component_count || memcmp(sections.sizes, component_sizes, sizeof(usize) * component_count) != 0) {
+		ERROR_RETURN(false, "ECS snapshot was saved with different components\n");
+	}
+
+	Ecs_Mask registered = component_count == ECS_MAX_COMPONENTS ? (Ecs_Mask)-1 : ECS_MASK(component_count) - 1;
+	u64 row_count = 0;
+	for (u64 i = 0; i < snapshot->archetype_count; ++i) {
+		const Ecs_Archetype_Snapshot *archetype_snapshot = &sections.archetypes[i];
+		if (archetype_snapshot->mask & ~registered) {
+			ERROR_RETURN(false, "ECS snapshot archetype uses an unregistered component\n");
+		}
+
+		// Same components and mask give the same layout, so chunks can be copied whole.
+		usize column_offsets[ECS_MAX_COMPONENTS];
+		if (archetype_snapshot->chunk_size != archetype_layout(archetype_snapshot->mask, column_offsets)) {
+			ERROR_RETURN(false, "ECS snapshot archetype layout does not match\n");
+		}
+
+		u64 count = archetype_snapshot->count;
+		if (archetype_snapshot->chunk_count != count / ECS_CHUNK_CAPACITY + (count % ECS_CHUNK_CAPACITY != 0)
+			|| !blob_array(data, len, archetype_snapshot->chunks, archetype_snapshot->chunk_count, archetype_snapshot->chunk_size)) {
+			ERROR_RETURN(false, "ECS snapshot chunks out of range\n");
+		}
+		row_count += count;
+	}
+
+	if (!ecs_snapshot_masks_are_unique(sections.archetypes, snapshot->archetype_count)) {
+		ERROR_RETURN(false, "ECS snapshot has two archetypes with the same mask\n");
+	}
+
+	// Every live location has to point at a stored row holding its own id. Rows hold one id each,
+	// so with as many live locations as rows, locations and rows match one to one.
+	u64 alive_count = 0;
+	for (u64 id = 0; id < snapshot->location_count; ++id) {
+		const Ecs_Location *location = &sections.locations[id];
+		if (!blob_bool_is_valid(&location->is_alive)) {
+			ERROR_RETURN(false, "ECS snapshot location %llu has a bad alive flag\n", (unsigned long long)id);
+		}
+		if (!location->is_alive) {
+			continue;
+		}
+
+		if (location->archetype >= snapshot->archetype_count) {
+			ERROR_RETURN(false, "ECS snapshot location out of range\n");
+		}
+		const Ecs_Archetype_Snapshot *archetype_snapshot = &sections.archetypes[location->archetype];
+		if (location->chunk >= archetype_snapshot->chunk_count || location->row >= ECS_CHUNK_CAPACITY
+			|| location->chunk * ECS_CHUNK_CAPACITY + location->row >= archetype_snapshot->count) {
+			ERROR_RETURN(false, "ECS snapshot location out of range\n");
+		}
+
+		const usize *ids = (const usize *)(data + archetype_snapshot->chunks + archetype_snapshot->chunk_size * location->chunk);
+		if (ids[location->row] != id) {
+			ERROR_RETURN(false, "ECS snapshot row does not hold entity %llu\n", (unsigned long long)id);
+		}
+		++alive_count;
+	}
+	if (alive_count != row_count) {
+		ERROR_RETURN(false, "ECS snapshot has rows without a live entity\n");
+	}
+
+	// create_in_archetype reuses these without checking, each has to be a distinct dead id.
+	u8 *is_listed = memory_alloc(snapshot->location_count ? snapshot->location_count : 1, MEMORY_TAG_ENTITY);
+	if (!is_listed) {
+		ERROR_EXIT("Could not allocate memory for ECS snapshot validation\n");
+	}
+	memset(is_listed, 0, snapshot->location_count);
+	bool is_free_list_valid = true;
+	for (u64 i = 0; i < snapshot->free_id_count && is_free_list_valid; ++i) {
+		usize id = sections.free_ids[i];
+		is_free_list_valid = id < snapshot->location_count && !sections.locations[id].is_alive && !is_listed[id];
+		if (is_free_list_valid) {
+			is_listed[id] = 1;
+		}
+	}
+	memory_free(is_listed);
+	if (!is_free_list_valid) {
+		ERROR_RETURN(false, "ECS snapshot free ids are not distinct dead ids\n");
+	}
+
+	if (!check) {
+		return true;
+	}
+
+	for (u64 i = 0; i < snapshot->archetype_count; ++i) {
+		const Ecs_Archetype_Snapshot *archetype_snapshot = &sections.archetypes[i];
+		usize column_offsets[ECS_MAX_COMPONENTS];
+		archetype_layout(archetype_snapshot->mask, column_offsets);
+
+		for (u64 j = 0; j < archetype_snapshot->chunk_count; ++j) {
+			u64 row_start = j * ECS_CHUNK_CAPACITY;
+			// Views are read-only here, they point into the blob.
+			u8 *chunk = (u8 *)(data + archetype_snapshot->chunks + archetype_snapshot->chunk_size * j);
+			Ecs_View view = {
+				.count = archetype_snapshot->count - row_start < ECS_CHUNK_CAPACITY ? archetype_snapshot->count - row_start : ECS_CHUNK_CAPACITY,
+				.entity_ids = (usize *)chunk,
+				.data = chunk,
+				.column_offsets = column_offsets,
+			};
+			if (!check(archetype_snapshot->mask, &view, context)) {
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+bool ecs_snapshot_is_alive(const u8 *data, usize len, u64 offset, usize id) {
+	const Ecs_Snapshot *snapshot = blob_at(data, len, offset, sizeof(Ecs_Snapshot));
+	const Ecs_Location *saved_locations = blob_array(data, len, snapshot->locations, snapshot->location_count, sizeof(Ecs_Location));
+	return id < snapshot->location_count && saved_locations[id].is_alive;
+}
+
+void ecs_snapshot_read(const u8 *data, usize len, u64 offset) {
+	const Ecs_Snapshot *snapshot = blob_at(data, len, offset, sizeof(Ecs_Snapshot));
+	Ecs_Snapshot_Sections sections = ecs_snapshot_sections(data, len, snapshot);
+	const Ecs_Archetype_Snapshot *archetype_snapshots = sections.archetypes;
+
+	ecs_clear();
+
+	// Saved archetype indices can differ from the live ones, locations are remapped below.
+	usize *archetype_remap = memory_alloc(sizeof(usize) * (snapshot->archetype_count + 1), MEMORY_TAG_ENTITY);
+	if (!archetype_remap) {
+		ERROR_EXIT("Could not allocate memory for ECS snapshot\n");
+	}
+
+	for (usize i = 0; i < snapshot->archetype_count; ++i) {
+		const Ecs_Archetype_Snapshot *archetype_snapshot = &archetype_snapshots[i];
+		archetype_remap[i] = archetype_find_or_create(archetype_snapshot->mask);
+		Ecs_Archetype *archetype = &archetypes.items[archetype_remap[i]];
+
+		const u8 *chunks = data + archetype_snapshot->chunks;
+		for (usize j = 0; j < archetype_snapshot->chunk_count; ++j) {
+			Ecs_Chunk *chunk = archetype_add_chunk(archetype);
+			memcpy(chunk->data, chunks + archetype_snapshot->chunk_size * j, archetype->chunk_size);
+			chunk->count = ECS_CHUNK_CAPACITY;
+		}
+		if (archetype->chunk_count > 0) {
+			archetype->chunks[archetype->chunk_count - 1].count = archetype_snapshot->count - (archetype->chunk_count - 1) * ECS_CHUNK_CAPACITY;
+		}
+		archetype->count = archetype_snapshot->count;
+	}
+
+	if (!array_Ecs_Location_assign(&locations, sections.locations, snapshot->location_count) || !array_usize_assign(&free_ids, sections.free_ids, snapshot->free_id_count)) {
+		ERROR_EXIT("Could not allocate memory for ECS snapshot\n");
+	}
+
+	for (usize i = 0; i < locations.len; ++i) {
+		if (locations.items[i].is_alive) {
+			locations.items[i].archetype = archetype_remap[locations.items[i].archetype];
+		}
+	}
+
+	memory_free(archetype_remap);
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <stdbool.h>
+
+#include "../types.h"
+#include "../io/blob.h"
+
+#define ECS_MAX_COMPONENTS 32
+// Rows per chunk. Every archetype stores its components column by column inside each chunk.
+#define ECS_CHUNK_CAPACITY 128
+#define ECS_MASK(component) ((Ecs_Mask)1 << (component))
+// Tag registered by ecs_init. Queries and ecs_count skip rows having it unless it is asked for in `all`,
+// so a disabled row keeps its id and data but no system sees it.
+#define ECS_DISABLED 0
+
+typedef u32 Ecs_Mask;
+
+// One chunk of a query result: count rows, and one packed column per component.
+typedef struct ecs_view {
+	usize count;
+	usize *entity_ids;
+	u8 *data;
+	usize *column_offsets;
+} Ecs_View;
+
+typedef struct ecs_query {
+	Ecs_Mask all;
+	Ecs_Mask none;
+	usize archetype;
+	usize chunk;
+} Ecs_Query;
+
+void ecs_init(void);
+// Size 0 registers a tag, which only affects which archetype an entity lives in.
+u32 ecs_component_register(usize size);
+
+// Components start zeroed.
+usize ecs_create(Ecs_Mask mask);
+// Creates count entities in the same archetype, writing their ids to ids.
+void ecs_create_batch(Ecs_Mask mask, usize count, usize *ids);
+// Swaps the archetype's last row into the hole, so pointers into that archetype are invalidated.
+void ecs_destroy(usize id);
+bool ecs_is_alive(usize id);
+bool ecs_has(usize id, u32 component);
+// NULL if the entity does not have the component.
+void *ecs_get(usize id, u32 component);
+// Moves the entity to the archetype with the component added/removed, keeping shared component data.
+void ecs_add(usize id, u32 component);
+void ecs_remove(usize id, u32 component);
+// Skips disabled rows unless ECS_DISABLED is in all.
+usize ecs_count(Ecs_Mask all);
+void ecs_clear(void);
+
+// Iterates every chunk whose archetype has all of `all` and none of `none`, disabled rows are skipped
+// unless ECS_DISABLED is in `all`:
+//   Ecs_Query query = ecs_query(ECS_MASK(a) | ECS_MASK(b), 0);
+//   Ecs_View view;
+//   while (ecs_query_next(&query, &view)) {
+//       A *as = ecs_view_column(&view, a);
+//       for (usize i = 0; i < view.count; ++i) { ... }
+//   }
+// Creating or destroying entities while iterating is not allowed.
+// Chunks are written as-is, so a snapshot only loads into a build with the same components registered.
+u64 ecs_snapshot_write(Blob_Writer *writer);
+// Called by ecs_snapshot_validate for every saved chunk, with the archetype's mask. The view points
+// into the blob and must not be written. Return false to reject the snapshot.
+typedef bool (*Ecs_Snapshot_Chunk_Check)(Ecs_Mask mask, Ecs_View *view, void *context);
+// Checks the section at offset without touching the world: counts against the blob, locations against
+// the rows they point at and free ids against the locations. check can be NULL.
+bool ecs_snapshot_validate(const u8 *data, usize len, u64 offset, Ecs_Snapshot_Chunk_Check check, void *context);
+// True if id is alive in a section that passed ecs_snapshot_validate.
+bool ecs_snapshot_is_alive(const u8 *data, usize len, u64 offset, usize id);
+// Replaces every entity with a section that passed ecs_snapshot_validate, entity ids are kept as saved.
+void ecs_snapshot_read(const u8 *data, usize len, u64 offset);
+
+Ecs_Query ecs_query(Ecs_Mask all, Ecs_Mask none);
+bool ecs_query_next(Ecs_Query *query, Ecs_View *view);
+
+static inline void *ecs_view_column(Ecs_View *view, u32 component) {
+	return view->data + view->column_offsets[component];
+}
@@ -1,59 +1,326 @@
+#include <stdlib.h>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define ENTITY_TAGS_SSE2
+#include <emmintrin.h>
+#endif
+
 #include "entity.h"
-#include "..\array_list\array_list.h"
+#include "..\ecs\ecs.h"
 #include "..\util.h"
+#include "..\array_list\array.h"
+#include "..\arena\arena.h"
+#include "..\animation\animation.h"
 
-static Array_List *entity_list;
+// Declaration order is the flush order.
+typedef enum entity_command_kind {
+	ENTITY_COMMAND_DESTROY,
+	ENTITY_COMMAND_SET_ANIMATION,
+	ENTITY_COMMAND_CREATE,
+	ENTITY_COMMAND_SPAWN,
+} Entity_Command_Kind;
 
-void entity_init(void) {
-	entity_list = array_list_create(sizeof(Entity), 0);
-}
+typedef struct entity_command {
+	Entity_Command_Kind kind;
+	// Recording order, keeps the sort stable so the last set_animation for an entity wins.
+	usize order;
+	usize entity_id;
+	usize animation_id;
+	usize prefab_id;
+	vec2 position;
+	Entity_Desc desc;
+} Entity_Command;
 
-usize entity_create(vec2 position, vec2 size, vec2 sprite_offset, vec2 velocity, u8 collision_layer, u8 collision_mask, bool is_kinematic, usize animation_id, On_Hit on_hit, On_Hit_Static on_hit_static) {
-	usize id = entity_list->len;
+typedef struct entity_prefab {
+	Ecs_Mask mask;
+	f32 lifetime;
+	u64 tags;
+	Entity entity;
+	Body body;
+	Animation animation;
+	// Destroyed entities of this prefab, parked as disabled rows until entity_spawn_batch reuses them.
+	Array_usize pool;
+} Entity_Prefab;
+
+typedef struct entity_snapshot {
+	u64 tag_count;
+	u64 tags;
+} Entity_Snapshot;
+
+DEFINE_ARRAY(u64)
+DEFINE_ARRAY(Entity_Command)
+DEFINE_ARRAY(Entity_Prefab)
 
-	// Find inactive Entity.
-	for (usize i = 0; i < entity_list->len; ++i) {
-		Entity *entity = array_list_get(entity_list, i);
-		if (!entity->is_active) {
-			id = i;
+Entity_Components entity_components;
+static Array_Entity_Command commands;
+static Array_Entity_Prefab prefabs;
+// Indexed by entity id, 0 for unused ids.
+static Array_u64 tag_masks;
+static vec2 cull_min;
+static vec2 cull_max;
+static bool has_cull_bounds;
+
+static Entity_Prefab *pooled_prefab(usize id) {
+	Entity *entity = ecs_get(id, entity_components.entity);
+	return entity && entity->prefab_id < prefabs.len ? &prefabs.items[entity->prefab_id] : NULL;
+}
+
+// A body destroyed straight through physics takes its entity's row with it, the tags would
+// otherwise stay alive until the id is reused and a pool would hand out a dead row.
+static void body_destroyed(usize body_id) {
+	Entity_Prefab *prefab = ecs_has(body_id, ECS_DISABLED) ? pooled_prefab(body_id) : NULL;
+	for (usize i = 0; prefab && i < prefab->pool.len; ++i) {
+		if (prefab->pool.items[i] == body_id) {
+			array_usize_remove(&prefab->pool, i);
 			break;
 		}
 	}
 
-	if (id == entity_list->len) {
-		if (array_list_append(entity_list, &(Entity){0}) == (usize)-1) {
-			ERROR_EXIT("Could not append entity to list\n");
+	if (body_id < tag_masks.len) {
+		tag_masks.items[body_id] = 0;
+	}
+}
+
+void entity_init(void) {
+	entity_components.entity = ecs_component_register(sizeof(Entity));
+	entity_components.lifetime = ecs_component_register(sizeof(f32));
+	entity_components.bounded = ecs_component_register(0);
+	physics_on_body_destroy_set(body_destroyed);
+	array_Entity_Command_init(&commands, 0, MEMORY_TAG_ENTITY);
+	array_Entity_Prefab_init(&prefabs, 0, MEMORY_TAG_ENTITY);
+	array_u64_init(&tag_masks, 0, MEMORY_TAG_ENTITY);
+}
+
+static Ecs_Mask desc_mask(const Entity_Desc *desc) {
+	Ecs_Mask mask = ECS_MASK(entity_components.entity) | ECS_MASK(physics_components.body);
+	if (desc->animation_id != (usize)-1) {
+		mask |= ECS_MASK(animation_components.animation);
+	}
+	if (desc->lifetime > 0) {
+		mask |= ECS_MASK(entity_components.lifetime);
+	}
+	if (desc->is_bounded) {
+		mask |= ECS_MASK(entity_components.bounded);
+	}
+
+	return mask;
+}
+
+static void set_tags(usize id, u64 tags) {
+	while (tag_masks.len <= id) {
+		if (array_u64_push(&tag_masks, 0) == (usize)-1) {
+			ERROR_EXIT("Could not grow entity tags\n");
 		}
 	}
+	tag_masks.items[id] = tags;
+}
+
+static void set_lifetime(usize id, f32 lifetime) {
+	f32 *remaining = ecs_get(id, entity_components.lifetime);
+	if (remaining) {
+		*remaining = lifetime;
+	}
+}
+
+static Body desc_body(const Entity_Desc *desc) {
+	Body body = physics_body_make((f32 *)desc->position, (f32 *)desc->size, (f32 *)desc->velocity, desc->collision_layer, desc->collision_mask, desc->is_kinematic, desc->on_hit, desc->on_hit_static);
+	body.is_projectile = desc->is_projectile;
+	return body;
+}
+
+// A missing template leaves the component zeroed, animation_get has already reported it.
+static Animation desc_animation(const Entity_Desc *desc) {
+	Animation *animation = desc->animation_id != (usize)-1 ? animation_get(desc->animation_id) : NULL;
+	return animation ? *animation : (Animation){0};
+}
+
+static void set_animation(usize id, const Animation *animation) {
+	Animation *component = ecs_get(id, animation_components.animation);
+	if (component) {
+		*component = *animation;
+	}
+}
+
+usize entity_spawn(const Entity_Desc *desc) {
+	usize id = ecs_create(desc_mask(desc));
+	Body body = desc_body(desc);
+	physics_body_add(id, &body);
 
 	Entity *entity = entity_get(id);
 
 	*entity = (Entity){
-		.is_active = true,
-		.animation_id = animation_id,
-		.body_id = physics_body_create(position, size, velocity, collision_layer, collision_mask, is_kinematic, on_hit, on_hit_static, id),
-        .sprite_offset = { sprite_offset[0], sprite_offset[1] },
+		.id = id,
+		.prefab_id = (usize)-1,
+        .sprite_offset = { desc->sprite_offset[0], desc->sprite_offset[1] },
+        .health = desc->health,
+	};
+	Animation animation = desc_animation(desc);
+	set_animation(id, &animation);
+	set_lifetime(id, desc->lifetime);
+	set_tags(id, desc->tags | ENTITY_TAG_ALIVE);
+
+	return id;
+}
+
+usize entity_prefab_create(const Entity_Desc *desc) {
+	Entity_Prefab prefab = {
+		.mask = desc_mask(desc),
+		.lifetime = desc->lifetime,
+		.tags = desc->tags | ENTITY_TAG_ALIVE,
+		.entity = {
+			.sprite_offset = { desc->sprite_offset[0], desc->sprite_offset[1] },
+			.health = desc->health,
+		},
+		.body = desc_body(desc),
+		.animation = desc_animation(desc),
 	};
 
+	usize id = array_Entity_Prefab_push(&prefabs, prefab);
+	if (id == (usize)-1) {
+		ERROR_EXIT("Could not create entity prefab\n");
+	}
+	array_usize_init(&prefabs.items[id].pool, 0, MEMORY_TAG_ENTITY);
+
 	return id;
 }
 
+void entity_spawn_batch(usize prefab_id, usize count, vec2 *positions, usize *ids) {
+	Entity_Prefab *prefab = array_Entity_Prefab_try_get(&prefabs, prefab_id);
+	if (!prefab) {
+		return;
+	}
+	Arena_Temp temp = arena_temp_begin(frame_arena_current());
+
+	usize *entity_ids = ids ? ids : ARENA_PUSH(temp.arena, usize, count);
+	if (!entity_ids) {
+		ERROR_EXIT("Could not allocate ids for entity_spawn_batch\n");
+	}
+
+	// Pooled rows are enabled again and reinitialized below like new ones, only the rest are created.
+	usize reused = count < prefab->pool.len ? count : prefab->pool.len;
+	for (usize i = 0; i < reused; ++i) {
+		entity_ids[i] = prefab->pool.items[--prefab->pool.len];
+		ecs_remove(entity_ids[i], ECS_DISABLED);
+	}
+	ecs_create_batch(prefab->mask, count - reused, entity_ids + reused);
+
+	for (usize i = 0; i < count; ++i) {
+		Body *body = physics_body_add(entity_ids[i], &prefab->body);
+		body->aabb.position[0] = positions[i][0];
+		body->aabb.position[1] = positions[i][1];
+
+		Entity *entity = entity_get(entity_ids[i]);
+		*entity = prefab->entity;
+		entity->id = entity_ids[i];
+		entity->prefab_id = prefab_id;
+		set_animation(entity_ids[i], &prefab->animation);
+		set_lifetime(entity_ids[i], prefab->lifetime);
+		set_tags(entity_ids[i], prefab->tags);
+	}
+
+	arena_temp_end(temp);
+}
+
+usize entity_create(vec2 position, vec2 size, vec2 sprite_offset, vec2 velocity, u8 collision_layer, u8 collision_mask, bool is_kinematic, usize animation_id, On_Hit on_hit, On_Hit_Static on_hit_static) {
+	Entity_Desc desc = {
+		.position = { position[0], position[1] },
+		.size = { size[0], size[1] },
+		.sprite_offset = { sprite_offset[0], sprite_offset[1] },
+		.velocity = { velocity[0], velocity[1] },
+		.animation_id = animation_id,
+		.on_hit = on_hit,
+		.on_hit_static = on_hit_static,
+		.collision_layer = collision_layer,
+		.collision_mask = collision_mask,
+		.is_kinematic = is_kinematic,
+	};
+
+	return entity_spawn(&desc);
+}
+
 Entity *entity_get(usize id) {
-	return array_list_get(entity_list, id);
+	if (ecs_has(id, ECS_DISABLED)) {
+		return NULL;
+	}
+	return ecs_get(id, entity_components.entity);
 }
 
 usize entity_count() {
-	return entity_list->len;
+	return ecs_count(ECS_MASK(entity_components.entity));
+}
+
+Entity_Iter entity_iter(Ecs_Mask with) {
+	return (Entity_Iter){
+		.query = ecs_query(with | ECS_MASK(entity_components.entity), 0),
+	};
+}
+
+Entity *entity_iter_next(Entity_Iter *iter) {
+	while (iter->index == iter->view.count) {
+		if (!ecs_query_next(&iter->query, &iter->view)) {
+			return NULL;
+		}
+		iter->entities = ecs_view_column(&iter->view, entity_components.entity);
+		iter->index = 0;
+	}
+
+	return &iter->entities[iter->index++];
+}
+
+void entity_set_animation(usize entity_id, usize animation_id) {
+    if (!entity_get(entity_id)) {
+        return;
+    }
+
+    if (animation_id == (usize)-1) {
+        ecs_remove(entity_id, animation_components.animation);
+        return;
+    }
+
+    Animation *template = animation_get(animation_id);
+    if (!template) {
+        return;
+    }
+
+    bool was_animated = ecs_has(entity_id, animation_components.animation);
+    ecs_add(entity_id, animation_components.animation);
+    Animation *animation = ecs_get(entity_id, animation_components.animation);
+
+    if (was_animated && animation->animation_definition_id == template->animation_definition_id) {
+        return;
+    }
+
+    // The facing comes from the entity, not the template.
+    bool is_flipped = animation->is_flipped;
+    *animation = *template;
+    animation->is_flipped = is_flipped;
 }
 
 void entity_reset(void) {
-    entity_list->len = 0;
+    ecs_clear();
+    commands.len = 0;
+    tag_masks.len = 0;
+    for (usize i = 0; i < prefabs.len; ++i) {
+        prefabs.items[i].pool.len = 0;
+    }
+}
+
+Entity *entity_by_body_id(usize body_id) {
+    return entity_get(body_id);
+}
+
+usize entity_id_by_body_id(usize body_id) {
+    return entity_get(body_id) ? body_id : (usize)-1;
 }
 
 bool entity_damage(usize entity_id, u8 amount) {
     Entity *entity = entity_get(entity_id);
+    if (!entity || !entity_is_active(entity_id)) {
+        return false;
+    }
+
     if (amount >= entity->health) {
-        entity_destroy(entity_id);
+        entity_command_destroy(entity_id);
         return true;
     }
 
@@ -62,7 +329,341 @@ bool entity_damage(usize entity_id, u8 amount) {
 }
 
 void entity_destroy(usize entity_id) {
-    Entity *entity = entity_get(entity_id);
-    physics_body_destroy(entity->body_id);
-    entity->is_active = false;
-}
\ No newline at end of file
+    if (!entity_get(entity_id)) {
+        return;
+    }
+
+    tag_masks.items[entity_id] = 0;
+
+    // The body is in the same row and goes with it, or is parked with it.
+    Entity_Prefab *prefab = pooled_prefab(entity_id);
+    if (!prefab) {
+        ecs_destroy(entity_id);
+        return;
+    }
+
+    physics_body_get(entity_id)->is_active = false;
+    ecs_add(entity_id, ECS_DISABLED);
+    if (array_usize_push(&prefab->pool, entity_id) == (usize)-1) {
+        ERROR_EXIT("Could not grow entity prefab pool\n");
+    }
+}
+
+u64 entity_tags(usize entity_id) {
+    return entity_id < tag_masks.len ? tag_masks.items[entity_id] : 0;
+}
+
+bool entity_has_tags(usize entity_id, u64 tags) {
+    return (entity_tags(entity_id) & tags) == tags;
+}
+
+bool entity_is_active(usize entity_id) {
+    return entity_has_tags(entity_id, ENTITY_TAG_ALIVE);
+}
+
+void entity_tag_add(usize entity_id, u64 tags) {
+    if (entity_get(entity_id)) {
+        tag_masks.items[entity_id] |= tags;
+    }
+}
+
+void entity_tag_remove(usize entity_id, u64 tags) {
+    if (entity_get(entity_id)) {
+        tag_masks.items[entity_id] &= ~tags | ENTITY_TAG_ALIVE;
+    }
+}
+
+usize entity_tag_query(u64 all, u64 none, usize **ids) {
+    all |= ENTITY_TAG_ALIVE;
+
+    usize len = tag_masks.len;
+    const u64 *masks = tag_masks.items;
+    usize *out = FRAME_PUSH(usize, len);
+    if (!out && len > 0) {
+        ERROR_EXIT("Could not allocate ids for entity_tag_query\n");
+    }
+
+    usize count = 0;
+    usize i = 0;
+
+#ifdef ENTITY_TAGS_SSE2
+    // A mask matches when both (all & ~mask) and (mask & none) are zero.
+    const __m128i all_v = _mm_set1_epi64x((long long)all);
+    const __m128i none_v = _mm_set1_epi64x((long long)none);
+    const __m128i zero = _mm_setzero_si128();
+
+    for (; i + 4 <= len; i += 4) {
+        __m128i a = _mm_loadu_si128((const __m128i *)(masks + i));
+        __m128i b = _mm_loadu_si128((const __m128i *)(masks + i + 2));
+        __m128i miss_a = _mm_or_si128(_mm_andnot_si128(a, all_v), _mm_and_si128(a, none_v));
+        __m128i miss_b = _mm_or_si128(_mm_andnot_si128(b, all_v), _mm_and_si128(b, none_v));
+
+        // One bit per 32 bit half that is zero, a 64 bit lane matches when both of its halves are.
+        int bits = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(miss_a, zero)))
+            | _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(miss_b, zero))) << 4;
+        if (bits == 0) {
+            continue;
+        }
+
+        for (usize lane = 0; lane < 4; ++lane) {
+            if (((bits >> (lane * 2)) & 3) == 3) {
+                out[count++] = i + lane;
+            }
+        }
+    }
+#endif
+
+    for (; i < len; ++i) {
+        if ((masks[i] & all) == all && (masks[i] & none) == 0) {
+            out[count++] = i;
+        }
+    }
+
+    *ids = out;
+    return count;
+}
+
+static void command_push(Entity_Command command) {
+    command.order = commands.len;
+    if (array_Entity_Command_push(&commands, command) == (usize)-1) {
+        ERROR_EXIT("Could not record entity command\n");
+    }
+}
+
+void entity_command_create(const Entity_Desc *desc) {
+    command_push((Entity_Command){ .kind = ENTITY_COMMAND_CREATE, .desc = *desc });
+}
+
+void entity_command_spawn(usize prefab_id, vec2 position) {
+    command_push((Entity_Command){ .kind = ENTITY_COMMAND_SPAWN, .prefab_id = prefab_id, .position = { position[0], position[1] } });
+}
+
+void entity_command_destroy(usize entity_id) {
+    if (!entity_get(entity_id) || !entity_is_active(entity_id)) {
+        return;
+    }
+
+    physics_body_get(entity_id)->is_active = false;
+    // entity_is_active and tag queries skip it from now on.
+    tag_masks.items[entity_id] &= ~ENTITY_TAG_ALIVE;
+    command_push((Entity_Command){ .kind = ENTITY_COMMAND_DESTROY, .entity_id = entity_id });
+}
+
+void entity_command_set_animation(usize entity_id, usize animation_id) {
+    command_push((Entity_Command){ .kind = ENTITY_COMMAND_SET_ANIMATION, .entity_id = entity_id, .animation_id = animation_id });
+}
+
+static int compare_commands(const void *a, const void *b) {
+    const Entity_Command *x = a;
+    const Entity_Command *y = b;
+
+    if (x->kind != y->kind) {
+        return (x->kind > y->kind) - (x->kind < y->kind);
+    }
+
+    if (x->kind == ENTITY_COMMAND_CREATE) {
+        Ecs_Mask mask_x = desc_mask(&x->desc);
+        Ecs_Mask mask_y = desc_mask(&y->desc);
+        if (mask_x != mask_y) {
+            return (mask_x > mask_y) - (mask_x < mask_y);
+        }
+    }
+
+    if (x->kind == ENTITY_COMMAND_SPAWN && x->prefab_id != y->prefab_id) {
+        return (x->prefab_id > y->prefab_id) - (x->prefab_id < y->prefab_id);
+    }
+
+    return (x->order > y->order) - (x->order < y->order);
+}
+
+void entity_commands_flush(void) {
+    if (commands.len == 0) {
+        return;
+    }
+
+    qsort(commands.items, commands.len, sizeof(Entity_Command), compare_commands);
+
+    for (usize i = 0; i < commands.len; ++i) {
+        Entity_Command *command = &commands.items[i];
+
+        switch (command->kind) {
+        case ENTITY_COMMAND_DESTROY:
+            entity_destroy(command->entity_id);
+            break;
+        case ENTITY_COMMAND_SET_ANIMATION:
+            // The entity may have been destroyed earlier in this flush.
+            if (ecs_is_alive(command->entity_id)) {
+                entity_set_animation(command->entity_id, command->animation_id);
+            }
+            break;
+        case ENTITY_COMMAND_CREATE:
+            entity_spawn(&command->desc);
+            break;
+        case ENTITY_COMMAND_SPAWN: {
+            usize run = 1;
+            while (i + run < commands.len && commands.items[i + run].kind == ENTITY_COMMAND_SPAWN && commands.items[i + run].prefab_id == command->prefab_id) {
+                ++run;
+            }
+
+            Arena_Temp temp = arena_temp_begin(frame_arena_current());
+            vec2 *positions = ARENA_PUSH(temp.arena, vec2, run);
+            if (!positions) {
+                ERROR_EXIT("Could not allocate positions for entity_commands_flush\n");
+            }
+            for (usize j = 0; j < run; ++j) {
+                positions[j][0] = commands.items[i + j].position[0];
+                positions[j][1] = commands.items[i + j].position[1];
+            }
+            entity_spawn_batch(command->prefab_id, run, positions, NULL);
+            arena_temp_end(temp);
+
+            i += run - 1;
+        } break;
+        }
+    }
+
+    commands.len = 0;
+}
+
+void entity_cull_set_bounds(vec2 min, vec2 max) {
+    cull_min[0] = min[0];
+    cull_min[1] = min[1];
+    cull_max[0] = max[0];
+    cull_max[1] = max[1];
+    has_cull_bounds = true;
+}
+
+void entity_cull_update(f32 delta) {
+    Ecs_Query query = ecs_query(ECS_MASK(entity_components.entity) | ECS_MASK(entity_components.lifetime), 0);
+    Ecs_View view;
+
+    while (ecs_query_next(&query, &view)) {
+        Entity *entities = ecs_view_column(&view, entity_components.entity);
+        f32 *lifetimes = ecs_view_column(&view, entity_components.lifetime);
+
+        for (usize i = 0; i < view.count; ++i) {
+            lifetimes[i] -= delta;
+            if (lifetimes[i] <= 0) {
+                entity_command_destroy(entities[i].id);
+            }
+        }
+    }
+
+    if (!has_cull_bounds) {
+        return;
+    }
+
+    query = ecs_query(ECS_MASK(entity_components.entity) | ECS_MASK(physics_components.body) | ECS_MASK(entity_components.bounded), 0);
+    while (ecs_query_next(&query, &view)) {
+        Entity *entities = ecs_view_column(&view, entity_components.entity);
+        Body *bodies = ecs_view_column(&view, physics_components.body);
+
+        for (usize i = 0; i < view.count; ++i) {
+            if (!(tag_masks.items[entities[i].id] & ENTITY_TAG_ALIVE)) {
+                continue;
+            }
+
+            f32 *position = bodies[i].aabb.position;
+            if (position[0] < cull_min[0] || position[0] > cull_max[0] || position[1] < cull_min[1] || position[1] > cull_max[1]) {
+                entity_command_destroy(entities[i].id);
+            }
+        }
+    }
+}
+
+u64 entity_snapshot_write(Blob_Writer *writer) {
+    u64 offset = blob_reserve(writer, sizeof(Entity_Snapshot));
+    Entity_Snapshot snapshot = {
+        .tag_count = tag_masks.len,
+        .tags = blob_write(writer, tag_masks.items, sizeof(u64) * tag_masks.len),
+    };
+
+    if (writer->data) {
+        memcpy(blob_ptr(writer, offset), &snapshot, sizeof(Entity_Snapshot));
+    }
+    return offset;
+}
+
+// Entity components are read back as-is. Live entities index tag_masks without a bounds check
+// and reach their body through their own id, pooled ones are respawned over their prefab's mask.
+bool entity_snapshot_check_chunk(const u8 *data, usize len, u64 offset, Ecs_Mask mask, Ecs_View *view) {
+    if (!(mask & ECS_MASK(entity_components.entity))) {
+        return true;
+    }
+
+    const Entity_Snapshot *snapshot = blob_at(data, len, offset, sizeof(Entity_Snapshot));
+    if (!snapshot) {
+        ERROR_RETURN(false, "Entity snapshot header out of range\n");
+    }
+    if (!(mask & ECS_MASK(physics_components.body))) {
+        ERROR_RETURN(false, "Entity snapshot has entities without a body\n");
+    }
+    const u64 *tags = blob_array(data, len, snapshot->tags, snapshot->tag_count, sizeof(u64));
+    if (!tags) {
+        ERROR_RETURN(false, "Entity snapshot section out of range\n");
+    }
+    bool is_pooled = mask & ECS_MASK(ECS_DISABLED);
+
+    Entity *entities = ecs_view_column(view, entity_components.entity);
+    for (usize i = 0; i < view->count; ++i) {
+        if (entities[i].id != view->entity_ids[i]) {
+            ERROR_RETURN(false, "Entity snapshot entity %zu is stored in the row of %zu\n", entities[i].id, view->entity_ids[i]);
+        }
+        if (entities[i].id >= snapshot->tag_count) {
+            ERROR_RETURN(false, "Entity snapshot entity %zu has no tags\n", entities[i].id);
+        }
+        if (entities[i].prefab_id != (usize)-1 && entities[i].prefab_id >= prefabs.len) {
+            ERROR_RETURN(false, "Entity snapshot entity %zu uses an unknown prefab\n", entities[i].id);
+        }
+        if (is_pooled && (entities[i].prefab_id == (usize)-1 || mask != (prefabs.items[entities[i].prefab_id].mask | ECS_MASK(ECS_DISABLED)) || tags[entities[i].id] != 0)) {
+            ERROR_RETURN(false, "Entity snapshot pooled entity %zu does not match its prefab\n", entities[i].id);
+        }
+    }
+
+    return true;
+}
+
+bool entity_snapshot_validate(const u8 *data, usize len, u64 offset, u64 ecs_offset) {
+    const Entity_Snapshot *snapshot = blob_at(data, len, offset, sizeof(Entity_Snapshot));
+    if (!snapshot) {
+        ERROR_RETURN(false, "Entity snapshot header out of range\n");
+    }
+
+    const u64 *tags = blob_array(data, len, snapshot->tags, snapshot->tag_count, sizeof(u64));
+    if (!tags) {
+        ERROR_RETURN(false, "Entity snapshot section out of range\n");
+    }
+
+    // Tag queries trust the alive bit.
+    for (u64 entity_id = 0; entity_id < snapshot->tag_count; ++entity_id) {
+        if ((tags[entity_id] & ENTITY_TAG_ALIVE) && !ecs_snapshot_is_alive(data, len, ecs_offset, entity_id)) {
+            ERROR_RETURN(false, "Entity snapshot tags entity %llu as alive\n", (unsigned long long)entity_id);
+        }
+    }
+    return true;
+}
+
+void entity_snapshot_read(const u8 *data, usize len, u64 offset) {
+    const Entity_Snapshot *snapshot = blob_at(data, len, offset, sizeof(Entity_Snapshot));
+    const u64 *tags = blob_array(data, len, snapshot->tags, snapshot->tag_count, sizeof(u64));
+
+    commands.len = 0;
+    if (!array_u64_assign(&tag_masks, tags, snapshot->tag_count)) {
+        ERROR_EXIT("Could not allocate memory for entity snapshot\n");
+    }
+
+    // Pools are not saved, the disabled rows are the pooled entities.
+    for (usize i = 0; i < prefabs.len; ++i) {
+        prefabs.items[i].pool.len = 0;
+    }
+    Ecs_Query query = ecs_query(ECS_MASK(entity_components.entity) | ECS_MASK(ECS_DISABLED), 0);
+    Ecs_View view;
+    while (ecs_query_next(&query, &view)) {
+        Entity *entities = ecs_view_column(&view, entity_components.entity);
+        for (usize i = 0; i < view.count; ++i) {
+            if (array_usize_push(&prefabs.items[entities[i].prefab_id].pool, entities[i].id) == (usize)-1) {
+                ERROR_EXIT("Could not grow entity prefab pool\n");
+            }
+        }
+    }
+}
@@ -4,25 +4,139 @@
 #include <linmath.h>
 
 #include "..\physics\physics.h"
+#include "..\ecs\ecs.h"
 #include "..\types.h"
 
+// An entity's body (physics_components.body) and animation (animation_components.animation) live in
+// the same ECS row, so systems read all three from one query and the body id is the entity id.
 typedef struct entity {
-	usize body_id;
-	usize animation_id;
+	usize id;
+	// Prefab the entity was spawned from, (usize)-1 for none. See entity_destroy.
+	usize prefab_id;
     vec2 sprite_offset;
-	bool is_active;
-    bool is_enraged;
     u8 health;
 } Entity;
 
+// Bit 63 is set for every live entity and cleared by entity_command_destroy, the other 63 bits are
+// free for gameplay tags.
+#define ENTITY_TAG_ALIVE ((u64)1 << 63)
+
+// Everything needed to spawn an entity and its body. Unset fields keep entity_create's defaults.
+typedef struct entity_desc {
+	vec2 position;
+	vec2 size;
+	vec2 sprite_offset;
+	vec2 velocity;
+	// Template copied into the animation component, (usize)-1 for none.
+	usize animation_id;
+	On_Hit on_hit;
+	On_Hit_Static on_hit_static;
+	// Seconds until entity_cull_update destroys the entity, 0 lives forever.
+	f32 lifetime;
+	u8 collision_layer;
+	u8 collision_mask;
+	u8 health;
+	bool is_kinematic;
+	bool is_projectile;
+	// Gameplay tag bits, see entity_tag_query.
+	u64 tags;
+	// Destroyed by entity_cull_update once its body leaves the cull bounds.
+	bool is_bounded;
+} Entity_Desc;
+
+// ECS components every entity module user can query on. All entities have `entity` and a body,
+// the ones with an animation_id also have an animation, `lifetime` is the f32 seconds left and
+// `bounded` tags entities culled outside the bounds.
+typedef struct entity_components {
+	u32 entity;
+	u32 lifetime;
+	u32 bounded;
+} Entity_Components;
+
+extern Entity_Components entity_components;
+
+// Walks the packed ECS chunks, so only live entities are visited and the cost scales with them:
+//   Entity_Iter iter = entity_iter(ECS_MASK(entity_components.lifetime));
+//   Entity *entity;
+//   while ((entity = entity_iter_next(&iter))) { ... }
+// Creating or destroying entities while iterating is not allowed.
+typedef struct entity_iter {
+	Ecs_Query query;
+	Ecs_View view;
+	Entity *entities;
+	usize index;
+} Entity_Iter;
+
+// Call after ecs_init, physics_init and animation_init.
 void entity_init(void);
 usize entity_create(vec2 position, vec2 size, vec2 sprite_offset, vec2 velocity, u8 collision_layer, u8 collision_mask, bool is_kinematic, usize animation_id, On_Hit on_hit, On_Hit_Static on_hit_static);
+usize entity_spawn(const Entity_Desc *desc);
+// Bakes desc into the Entity, Body and Animation values every spawn of the prefab starts from. Prefabs survive entity_reset.
+usize entity_prefab_create(const Entity_Desc *desc);
+// Spawns count copies of a prefab in one pass, the desc position is replaced by positions[i].
+// ids can be NULL, otherwise it receives the new entity ids.
+// Does nothing for an unknown prefab_id.
+void entity_spawn_batch(usize prefab_id, usize count, vec2 *positions, usize *ids);
+// Entities live in ECS chunks, so the pointer is only valid until the next destroy or entity_set_animation.
+// NULL for destroyed ids, including pooled ones.
 Entity *entity_get(usize id);
 usize entity_count(void);
+// Live entities having every component in `with`, the `entity` component is always implied.
+Entity_Iter entity_iter(Ecs_Mask with);
+Entity *entity_iter_next(Entity_Iter *iter);
+// Copies the template into the entity's animation component, adding or removing the component as
+// needed. Switching to a template with the definition already playing keeps the current frame.
+void entity_set_animation(usize entity_id, usize animation_id);
 void entity_reset(void);
+// The body shares its entity's row, so this is an ECS lookup of the same id.
+// NULL / (usize)-1 for bodies without an entity, e.g. triggers.
 Entity *entity_by_body_id(usize body_id);
 usize entity_id_by_body_id(usize body_id);
 
-// Returns true if the enemy dies.
+// Tags are one u64 per entity id in a dense array, so filters scan it instead of the entities.
+u64 entity_tags(usize entity_id);
+bool entity_has_tags(usize entity_id, u64 tags);
+// False once entity_command_destroy is called, even though the row lives until the flush.
+bool entity_is_active(usize entity_id);
+void entity_tag_add(usize entity_id, u64 tags);
+void entity_tag_remove(usize entity_id, u64 tags);
+// Ids of live entities having every tag in `all` and none in `none`, scanned 4 masks at a time with SSE2
+// where available. The ids are allocated in the frame arena, returns the count.
+usize entity_tag_query(u64 all, u64 none, usize **ids);
+
+// Returns true if the enemy dies, false for dead or unknown ids. Safe inside physics callbacks, the kill goes through entity_command_destroy.
 bool entity_damage(usize entity_id, u8 amount);
-void entity_destroy(usize entity_id);
\ No newline at end of file
+// Entities spawned from a prefab are pooled: the row is disabled and kept with its body, and the next
+// entity_spawn_batch of that prefab reuses it instead of creating a row. A prefab's pool never holds
+// more than its peak live count, so memory stays bounded however long the session runs.
+void entity_destroy(usize entity_id);
+
+// Command buffer for structural changes requested while systems iterate (e.g. from physics callbacks).
+// Commands are applied by entity_commands_flush at the frame's sync point, sorted so all destroys run
+// first, then component changes, then creates grouped by archetype so their storage is allocated in runs.
+void entity_command_create(const Entity_Desc *desc);
+// Consecutive spawns of the same prefab are flushed with a single entity_spawn_batch.
+void entity_command_spawn(usize prefab_id, vec2 position);
+// The entity and its body are deactivated at once so they stop colliding, storage is freed on flush.
+void entity_command_destroy(usize entity_id);
+void entity_command_set_animation(usize entity_id, usize animation_id);
+void entity_commands_flush(void);
+
+// Destroyed prefab entities go back to their prefab's pool, so culling bounds memory and step cost
+// in long sessions. Entities past their lifetime or outside the bounds are destroyed through the
+// command buffer, run it right before entity_commands_flush.
+void entity_cull_set_bounds(vec2 min, vec2 max);
+void entity_cull_update(f32 delta);
+
+// Entity tags. The entities themselves are rows of the ECS section, pooled ones included. Pending commands are not saved,
+// write at the frame's sync point.
+u64 entity_snapshot_write(Blob_Writer *writer);
+// ecs_snapshot_validate check for saved chunks holding entities, against the tags section at offset:
+// each entity carries its row's id, has a body and has tags, and pooled ones match their prefab.
+bool entity_snapshot_check_chunk(const u8 *data, usize len, u64 offset, Ecs_Mask mask, Ecs_View *view);
+// Checks the section at offset without touching the world, including that every id tagged alive is
+// alive in the ECS section, which must be validated first.
+bool entity_snapshot_validate(const u8 *data, usize len, u64 offset, u64 ecs_offset);
+// Replaces the tags with a section that passed entity_snapshot_validate and refills the prefab pools
+// from the disabled rows, load the ECS section first.
+void entity_snapshot_read(const u8 *data, usize len, u64 offset);
\ No newline at end of file
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <stdbool.h>
+#include <string.h>
+
+#include "../types.h"
+
+#define BLOB_ALIGNMENT 16
+
+// Builds a flat, pointer-free buffer in which every array is found by its offset from the start,
+// so it can be written to disk and mapped straight back. Run the writes once with data NULL to
+// measure len, then again into a buffer of that size.
+typedef struct blob_writer {
+	u8 *data;
+	usize len;
+} Blob_Writer;
+
+// Reserves size bytes at the next aligned offset and returns that offset.
+static inline u64 blob_reserve(Blob_Writer *writer, usize size) {
+	writer->len = (writer->len + BLOB_ALIGNMENT - 1) & ~(usize)(BLOB_ALIGNMENT - 1);
+	u64 offset = writer->len;
+	writer->len += size;
+	return offset;
+}
+
+// NULL during the sizing pass.
+static inline void *blob_ptr(Blob_Writer *writer, u64 offset) {
+	return writer->data ? writer->data + offset : NULL;
+}
+
+static inline u64 blob_write(Blob_Writer *writer, const void *src, usize size) {
+	u64 offset = blob_reserve(writer, size);
+	if (writer->data && size > 0) {
+		memcpy(writer->data + offset, src, size);
+	}
+	return offset;
+}
+
+// NULL if [offset, offset + size) is outside the blob, so a truncated or corrupt file is never read past its end.
+// Offsets come from blob_reserve, one that is not aligned is corrupt.
+static inline const void *blob_at(const u8 *data, usize len, u64 offset, u64 size) {
+	if (offset % BLOB_ALIGNMENT != 0 || offset > len || size > len - offset) {
+		return NULL;
+	}
+	return data + offset;
+}
+
+// NULL unless count items of item_size fit at offset. Use this for saved counts instead of blob_at with
+// count * item_size, the division keeps a crafted count from wrapping the product into a small size.
+static inline const void *blob_array(const u8 *data, usize len, u64 offset, u64 count, usize item_size) {
+	if (offset % BLOB_ALIGNMENT != 0 || offset > len || count > (len - offset) / item_size) {
+		return NULL;
+	}
+	return data + offset;
+}
+
+// Saved bools are read as a byte first, anything but 0 or 1 is not a valid bool.
+static inline bool blob_bool_is_valid(const bool *value) {
+	u8 byte;
+	memcpy(&byte, value, 1);
+	return byte <= 1;
+}
@@ -5,6 +5,7 @@
 #include "../types.h"
 #include "../util.h"
 #include "io.h"
+#include "../memory/memory.h"
 
 // 20 MiB, can probably make this larger without issue depending on target platform
 #define IO_READ_CHUNK_SIZE 2097152
@@ -35,9 +36,9 @@ File io_file_read(const char* path) {
 				ERROR_RETURN(file, "Input file too large: %s\n", path);
 			}
 
-			tmp = realloc(data, size);
+			tmp = memory_realloc(data, size, MEMORY_TAG_ASSET);
 			if (!tmp) {
-				free(data);
+				memory_free(data);
 				ERROR_RETURN(file, IO_READ_ERROR_MEMORY, path);
 			}
 			data = tmp;
@@ -49,12 +50,12 @@ File io_file_read(const char* path) {
 		used += n;
 	}
 	if (ferror(fp)) {
-		free(data);
+		memory_free(data);
 		ERROR_RETURN(file, IO_READ_ERROR_GENERAL, path, errno);
 	}
-	tmp = realloc(data, used +1);
+	tmp = memory_realloc(data, used +1, MEMORY_TAG_ASSET);
 	if (!tmp) {
-		free(data);
+		memory_free(data);
 		ERROR_RETURN(file, IO_READ_ERROR_MEMORY, path);
 	}
 	data = tmp;
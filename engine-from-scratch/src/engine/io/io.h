@@ -9,5 +9,6 @@ typedef struct file {
 	bool is_valid;
 } File;
 
+// data is allocated with memory_alloc (MEMORY_TAG_ASSET), release it with memory_free.
 File io_file_read(const char* path);
 int io_file_write(void* buffer, size_t size, const char* path);
@@ -0,0 +1,116 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+
+#include "memory.h"
+#include "../util.h"
+
+// Stored in front of every allocation so free and realloc know what to uncount.
+// Padded to 16 bytes to keep the returned pointer aligned like malloc's.
+typedef struct memory_header {
+	usize size;
+	u32 tag;
+} Memory_Header;
+
+#define MEMORY_HEADER_SIZE 16
+
+static Memory_Stats stats[MEMORY_TAG_COUNT];
+
+static const char *tag_names[MEMORY_TAG_COUNT] = {
+	"PHYSICS",
+	"RENDER",
+	"ENTITY",
+	"ASSET",
+	"AUDIO",
+	"FRAME",
+};
+
+static bool is_over_budget(Memory_Tag tag, usize old_size, usize new_size) {
+	Memory_Stats *tag_stats = &stats[tag];
+	return tag_stats->budget > 0 && tag_stats->live_bytes - old_size + new_size > tag_stats->budget;
+}
+
+static void count_alloc(Memory_Tag tag, usize size) {
+	Memory_Stats *tag_stats = &stats[tag];
+	tag_stats->live_bytes += size;
+	++tag_stats->live_allocations;
+	++tag_stats->allocation_count;
+	if (tag_stats->live_bytes > tag_stats->peak_bytes) {
+		tag_stats->peak_bytes = tag_stats->live_bytes;
+	}
+}
+
+void *memory_alloc(usize size, Memory_Tag tag) {
+	if (is_over_budget(tag, 0, size)) {
+		ERROR_RETURN(NULL, "Memory budget exceeded for %s: %zu + %zu > %zu bytes\n", tag_names[tag], stats[tag].live_bytes, size, stats[tag].budget);
+	}
+
+	u8 *block = malloc(MEMORY_HEADER_SIZE + size);
+	if (!block) {
+		return NULL;
+	}
+
+	*(Memory_Header *)block = (Memory_Header){ .size = size, .tag = tag };
+	count_alloc(tag, size);
+
+	return block + MEMORY_HEADER_SIZE;
+}
+
+void *memory_realloc(void *ptr, usize size, Memory_Tag tag) {
+	if (!ptr) {
+		return memory_alloc(size, tag);
+	}
+
+	u8 *block = (u8 *)ptr - MEMORY_HEADER_SIZE;
+	Memory_Header header = *(Memory_Header *)block;
+
+	if (is_over_budget(header.tag, header.size, size)) {
+		ERROR_RETURN(NULL, "Memory budget exceeded for %s: %zu + %zu > %zu bytes\n", tag_names[header.tag], stats[header.tag].live_bytes - header.size, size, stats[header.tag].budget);
+	}
+
+	block = realloc(block, MEMORY_HEADER_SIZE + size);
+	if (!block) {
+		return NULL;
+	}
+
+	((Memory_Header *)block)->size = size;
+
+	Memory_Stats *tag_stats = &stats[header.tag];
+	tag_stats->live_bytes = tag_stats->live_bytes - header.size + size;
+	++tag_stats->allocation_count;
+	if (tag_stats->live_bytes > tag_stats->peak_bytes) {
+		tag_stats->peak_bytes = tag_stats->live_bytes;
+	}
+
+	return block + MEMORY_HEADER_SIZE;
+}
+
+void memory_free(void *ptr) {
+	if (!ptr) {
+		return;
+	}
+
+	u8 *block = (u8 *)ptr - MEMORY_HEADER_SIZE;
+	Memory_Header *header = (Memory_Header *)block;
+
+	stats[header->tag].live_bytes -= header->size;
+	--stats[header->tag].live_allocations;
+
+	free(block);
+}
+
+void memory_set_budget(Memory_Tag tag, usize budget) {
+	stats[tag].budget = budget;
+}
+
+Memory_Stats memory_stats(Memory_Tag tag) {
+	return stats[tag];
+}
+
+void memory_dump(void) {
+	printf("%-8s %12s %12s %8s %8s %12s\n", "tag", "live", "peak", "live#", "allocs", "budget");
+	for (u32 i = 0; i < MEMORY_TAG_COUNT; ++i) {
+		Memory_Stats *tag_stats = &stats[i];
+		printf("%-8s %12zu %12zu %8zu %8zu %12zu\n", tag_names[i], tag_stats->live_bytes, tag_stats->peak_bytes, tag_stats->live_allocations, tag_stats->allocation_count, tag_stats->budget);
+	}
+}
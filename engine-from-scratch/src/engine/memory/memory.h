@@ -0,0 +1,31 @@
+#pragma once
+
+#include "../types.h"
+
+typedef enum memory_tag {
+	MEMORY_TAG_PHYSICS,
+	MEMORY_TAG_RENDER,
+	MEMORY_TAG_ENTITY,
+	MEMORY_TAG_ASSET,
+	MEMORY_TAG_AUDIO,
+	MEMORY_TAG_FRAME,
+	MEMORY_TAG_COUNT
+} Memory_Tag;
+
+typedef struct memory_stats {
+	usize live_bytes;
+	usize peak_bytes;
+	usize live_allocations;
+	usize allocation_count;
+	usize budget; // 0 means no budget.
+} Memory_Stats;
+
+// Same contract as malloc/realloc/free, but every allocation is counted against its tag.
+// Returns NULL when the tag's budget would be exceeded.
+void *memory_alloc(usize size, Memory_Tag tag);
+void *memory_realloc(void *ptr, usize size, Memory_Tag tag);
+void memory_free(void *ptr);
+
+void memory_set_budget(Memory_Tag tag, usize budget);
+Memory_Stats memory_stats(Memory_Tag tag);
+void memory_dump(void);
@@ -1,18 +1,48 @@
 
+#include <stdlib.h>
+#include <string.h>
 #include <linmath.h>
 
 #include "physics.h"
 #include "physics_internal.h"
 
 #include "../global.h"
-#include "../array_list/array_list.h"
 #include "../util.h"
+#include "../memory/memory.h"
 
 static Physics_State_Internal state;
+Physics_Components physics_components;
+
+#define COALESCE_EPSILON 0.001f
+#define STATIC_GRID_CELL_SIZE 32
+#define STATIC_GRID_MAX_CELLS (1 << 20)
 
 static u32 iterations = 4;
 static f32 tick_rate;
 
+DEFINE_ARRAY(On_Hit)
+DEFINE_ARRAY(On_Hit_Static)
+
+static On_Body_Destroy on_body_destroy;
+
+// Index + 1 is the callback id stored in bodies.
+static Array_On_Hit on_hit_registry;
+static Array_On_Hit_Static on_hit_static_registry;
+
+// Bodies are ECS rows and are saved with the ECS section, this holds the statics and their grid.
+typedef struct physics_snapshot {
+	u64 static_body_count;
+	u64 static_bodies;
+	vec2 grid_origin;
+	f32 grid_cell_size;
+	u32 grid_columns;
+	u32 grid_rows;
+	u32 grid_is_valid;
+	u64 grid_cell_start;
+	u64 grid_cell_item_count;
+	u64 grid_cell_items;
+} Physics_Snapshot;
+
 void aabb_min_max(vec2 min, vec2 max, AABB aabb) {
 	vec2_sub(min, aabb.position, aabb.half_size);
 	vec2_add(max, aabb.position, aabb.half_size);
@@ -110,8 +140,10 @@ bool physics_point_intersect_aabb(vec2 point, AABB aabb) {
 }
 
 void physics_init(void) {
-	state.body_list = array_list_create(sizeof(Body), 0);
-	state.static_body_list = array_list_create(sizeof(Static_Body), 0);
+	physics_components.body = ecs_component_register(sizeof(Body));
+	array_Static_Body_init(&state.static_body_list, 0, MEMORY_TAG_PHYSICS);
+	array_On_Hit_init(&on_hit_registry, 0, MEMORY_TAG_PHYSICS);
+	array_On_Hit_Static_init(&on_hit_static_registry, 0, MEMORY_TAG_PHYSICS);
 	//currently can't have enemies taht move slower than gravity, an event queue can fix this but it's complicated
 	state.gravity = -79;
 	state.terminal_velocity = -7000;
@@ -119,9 +151,19 @@ void physics_init(void) {
 	tick_rate = 1.f / iterations;
 }
 
-static void update_sweep_result(Hit *result, Body *body, usize other_id, vec2 velocity) {
-	Body *other = physics_body_get(other_id);
+static void body_on_hit(Body *body, Body *other, Hit hit) {
+	if (body->on_hit_id) {
+		on_hit_registry.items[body->on_hit_id - 1](body, other, hit);
+	}
+}
 
+static void body_on_hit_static(Body *body, Static_Body *other, Hit hit) {
+	if (body->on_hit_static_id) {
+		on_hit_static_registry.items[body->on_hit_static_id - 1](body, other, hit);
+	}
+}
+
+static void update_sweep_result(Hit *result, Body *body, Body *other, vec2 velocity) {
 	if ((body->collision_mask & other->collision_layer) == 0) {
 		return;
 	}
@@ -131,8 +173,8 @@ static void update_sweep_result(Hit *result, Body *body, usize other_id, vec2 ve
 
 	Hit hit = ray_intersect_aabb(body->aabb.position, velocity, sum_aabb);
 	if (hit.is_hit) {
-		if (body->on_hit && (body->collision_mask & other->collision_layer) == 0) {
-			body->on_hit(body, other, hit);
+		if (body->on_hit_id && (body->collision_mask & other->collision_layer) == 0) {
+			body_on_hit(body, other, hit);
 		}
 
 		if (hit.time < result->time) {
@@ -146,7 +188,7 @@ static void update_sweep_result(Hit *result, Body *body, usize other_id, vec2 ve
 			}
 		}
 
-		result->other_id = other_id;
+		result->other_id = other->id;
 	}
 }
 
@@ -180,7 +222,7 @@ static void update_sweep_result_static(Hit *result, Body *body, usize other_id,
 static Hit sweep_static_bodies(Body *body, vec2 velocity) {
 	Hit result = {.time = 0xBEEF};
 
-	for (u32 i = 0; i < state.static_body_list->len; ++i) {
+	for (u32 i = 0; i < state.static_body_list.len; ++i) {
 		update_sweep_result_static(&result, body, i, velocity);
 	}
 
@@ -190,29 +232,26 @@ static Hit sweep_static_bodies(Body *body, vec2 velocity) {
 static Hit sweep_bodies(Body *body, vec2 velocity) {
 	Hit result = {.time = 0xBEEF};
 
-	for (u32 i = 0; i < state.body_list->len; ++i) {
-		Body *other = physics_body_get(i);
+	Ecs_Query query = ecs_query(ECS_MASK(physics_components.body), 0);
+	Ecs_View view;
+	while (ecs_query_next(&query, &view)) {
+		Body *others = ecs_view_column(&view, physics_components.body);
 
-		if (body == other) {
-			continue;
-		}
+		for (usize i = 0; i < view.count; ++i) {
+			Body *other = &others[i];
+
+			if (body == other || !other->is_active) {
+				continue;
+			}
 
-		update_sweep_result(&result, body, i, velocity);
+			update_sweep_result(&result, body, other, velocity);
+		}
 	}
 
 	return result;
 }
 
-static void sweep_response(Body *body, vec2 velocity) {
-	Hit hit = sweep_static_bodies(body, velocity);
-	Hit hit_moving = sweep_bodies(body, velocity);
-
-	if (hit_moving.is_hit) {
-		if (body->on_hit != NULL) {
-			body->on_hit(body, physics_body_get(hit_moving.other_id), hit_moving);
-		}
-	}
-
+static void static_hit_response(Body *body, vec2 velocity, Hit hit) {
 	if (hit.is_hit) {
 		body->aabb.position[0] = hit.position[0];
 		body->aabb.position[1] = hit.position[1];
@@ -225,16 +264,32 @@ static void sweep_response(Body *body, vec2 velocity) {
 			body->velocity[1] = 0;
 		}
 
-		if (body->on_hit_static != NULL) {
-			body->on_hit_static(body, physics_static_body_get(hit.other_id), hit);
-		}
+		body_on_hit_static(body, physics_static_body_get(hit.other_id), hit);
 	} else {
 		vec2_add(body->aabb.position, body->aabb.position, velocity);
 	}
 }
 
+static void sweep_response(Body *body, vec2 velocity) {
+	Hit hit = sweep_static_bodies(body, velocity);
+	Hit hit_moving = sweep_bodies(body, velocity);
+
+	if (hit_moving.is_hit) {
+		body_on_hit(body, physics_body_get(hit_moving.other_id), hit_moving);
+	}
+
+	// The callback may have destroyed this body.
+	if (!body->is_active) {
+		return;
+	}
+
+	static_hit_response(body, velocity, hit);
+}
+
+static void overlap_response(Body *body, usize skip_id);
+
 static void stationary_response(Body *body) {
-	for (u32 i = 0; i < state.static_body_list->len; ++i) {
+	for (u32 i = 0; i < state.static_body_list.len; ++i) {
 		Static_Body *static_body = physics_static_body_get(i);
 
 		if ((body->collision_mask & static_body->collision_layer) == 0) {
@@ -253,79 +308,204 @@ static void stationary_response(Body *body) {
 		}
 	}
 
+	overlap_response(body, (usize)-1);
+}
+
+// skip_id is a body on_hit already fired for this frame, or (usize)-1.
+static void overlap_response(Body *body, usize skip_id) {
 	// Check for on-hit events.
-	for (usize i = 0; i < state.body_list->len; ++i) {
-		Body *other = physics_body_get(i);
+	Ecs_Query query = ecs_query(ECS_MASK(physics_components.body), 0);
+	Ecs_View view;
+	while (ecs_query_next(&query, &view)) {
+		Body *others = ecs_view_column(&view, physics_components.body);
 
-		if (!body->on_hit) {
-			continue;
-		}
+		for (usize i = 0; i < view.count; ++i) {
+			Body *other = &others[i];
 
-		if ((body->collision_mask & other->collision_layer) == 0) {
-			continue;
-		}
+			if (!body->on_hit_id || !body->is_active) {
+				return;
+			}
 
-		AABB aabb = aabb_minkowski_difference(other->aabb, body->aabb);
-		vec2 min, max;
-		aabb_min_max(min, max, aabb);
+			if (!other->is_active || other->id == skip_id) {
+				continue;
+			}
 
-		if (min[0] <= 0 && max[0] >= 0 && min[1] <= 0 && max[1] >= 0) {
-			body->on_hit(body, other, (Hit){.is_hit = true, .other_id = i});
+			if ((body->collision_mask & other->collision_layer) == 0) {
+				continue;
+			}
+
+			AABB aabb = aabb_minkowski_difference(other->aabb, body->aabb);
+			vec2 min, max;
+			aabb_min_max(min, max, aabb);
+
+			if (min[0] <= 0 && max[0] >= 0 && min[1] <= 0 && max[1] >= 0) {
+				body_on_hit(body, other, (Hit){.is_hit = true, .other_id = other->id});
+			}
 		}
 	}
 }
 
-void physics_update(void) {
-	Body *body;
+// Amanatides-Woo traversal of the static grid. Cells are visited in ray order, so the
+// first hit that lands inside the current cell is the closest one.
+static Hit static_grid_raycast(Body *body, vec2 velocity) {
+	Static_Grid *grid = &state.static_grid;
+	Hit result = {.time = 0xBEEF};
 
-	for (u32 i = 0; i < state.body_list->len; ++i) {
-		body = array_list_get(state.body_list, i);
+	vec2 grid_max = {
+		grid->origin[0] + grid->columns * grid->cell_size,
+		grid->origin[1] + grid->rows * grid->cell_size,
+	};
 
-		if (!body->is_active) {
-			continue;
+	// Clip the ray to the grid bounds, nothing outside of it can be hit.
+	f32 t_enter = 0;
+	f32 t_exit = 1;
+	for (u8 i = 0; i < 2; ++i) {
+		if (velocity[i] != 0) {
+			f32 t1 = (grid->origin[i] - body->aabb.position[i]) / velocity[i];
+			f32 t2 = (grid_max[i] - body->aabb.position[i]) / velocity[i];
+			t_enter = fmaxf(t_enter, fminf(t1, t2));
+			t_exit = fminf(t_exit, fmaxf(t1, t2));
+		} else if (body->aabb.position[i] < grid->origin[i] || body->aabb.position[i] > grid_max[i]) {
+			return result;
 		}
+	}
 
-		if (!body->is_kinematic) {
-			body->velocity[1] += state.gravity;
-			if (state.terminal_velocity > body->velocity[1]) {
-				body->velocity[1] = state.terminal_velocity;
-			}
+	if (t_enter > t_exit) {
+		return result;
+	}
+
+	i32 cell[2];
+	i32 step[2];
+	i32 cell_count[2] = { grid->columns, grid->rows };
+	f32 t_max[2];
+	f32 t_delta[2];
+
+	for (u8 i = 0; i < 2; ++i) {
+		f32 start = body->aabb.position[i] + velocity[i] * t_enter - grid->origin[i];
+		cell[i] = (i32)floorf(start / grid->cell_size);
+		if (cell[i] < 0) {
+			cell[i] = 0;
+		} else if (cell[i] >= cell_count[i]) {
+			cell[i] = cell_count[i] - 1;
 		}
 
-		body->velocity[0] += body->acceleration[0];
-		body->velocity[1] += body->acceleration[1];
+		if (velocity[i] > 0) {
+			step[i] = 1;
+			t_max[i] = ((cell[i] + 1) * grid->cell_size - (body->aabb.position[i] - grid->origin[i])) / velocity[i];
+			t_delta[i] = grid->cell_size / velocity[i];
+		} else if (velocity[i] < 0) {
+			step[i] = -1;
+			t_max[i] = (cell[i] * grid->cell_size - (body->aabb.position[i] - grid->origin[i])) / velocity[i];
+			t_delta[i] = -grid->cell_size / velocity[i];
+		} else {
+			step[i] = 0;
+			t_max[i] = INFINITY;
+			t_delta[i] = INFINITY;
+		}
+	}
+
+	while (true) {
+		u32 index = cell[1] * grid->columns + cell[0];
+		for (u32 i = grid->cell_start[index]; i < grid->cell_start[index + 1]; ++i) {
+			update_sweep_result_static(&result, body, grid->cell_items[i], velocity);
+		}
 
-		vec2 scaled_velocity;
-		vec2_scale(scaled_velocity, body->velocity, global.time.delta * tick_rate);
+		f32 t_cell_exit = fminf(t_max[0], t_max[1]);
+		if (result.is_hit && result.time <= t_cell_exit) {
+			return result;
+		}
+		if (t_cell_exit > t_exit) {
+			return result;
+		}
 
-		for (u32 j = 0; j < iterations; ++j) {
-			sweep_response(body, scaled_velocity);
-			stationary_response(body);
+		u8 axis = t_max[0] < t_max[1] ? 0 : 1;
+		cell[axis] += step[axis];
+		if (cell[axis] < 0 || cell[axis] >= cell_count[axis]) {
+			return result;
 		}
+		t_max[axis] += t_delta[axis];
 	}
 }
 
-usize physics_body_create(vec2 position, vec2 size, vec2 velocity, u8 collision_layer, u8 collision_mask, bool is_kinematic, On_Hit on_hit, On_Hit_Static on_hit_static, usize entity_id) {
-	usize id = state.body_list->len;
+static bool can_use_static_grid(Body *body) {
+	return body->is_projectile &&
+		state.static_grid.is_valid &&
+		body->aabb.half_size[0] <= PHYSICS_PROJECTILE_MAX_HALF_SIZE &&
+		body->aabb.half_size[1] <= PHYSICS_PROJECTILE_MAX_HALF_SIZE;
+}
 
-	// Find inactive Body.
-	for (usize i = 0; i < state.body_list->len; ++i) {
-		Body *body = array_list_get(state.body_list, i);
-		if (!body->is_active) {
-			id = i;
-			break;
+static void projectile_response(Body *body, vec2 velocity) {
+	Hit hit_moving = sweep_bodies(body, velocity);
+
+	if (hit_moving.is_hit) {
+		body_on_hit(body, physics_body_get(hit_moving.other_id), hit_moving);
+	}
+
+	if (!body->is_active) {
+		return;
+	}
+
+	static_hit_response(body, velocity, static_grid_raycast(body, velocity));
+
+	// The sweep already reported its body, a second on_hit for the same pair would apply damage twice.
+	if (body->is_active) {
+		overlap_response(body, hit_moving.is_hit ? hit_moving.other_id : (usize)-1);
+	}
+}
+
+static void body_update(Body *body) {
+	if (!body->is_active) {
+		return;
+	}
+
+	if (!body->is_kinematic) {
+		body->velocity[1] += state.gravity;
+		if (state.terminal_velocity > body->velocity[1]) {
+			body->velocity[1] = state.terminal_velocity;
 		}
 	}
 
-	if (id == state.body_list->len) {
-		if (array_list_append(state.body_list, &(Body){0}) == (usize)-1) {
-			ERROR_EXIT("Could not append body to list\n");
+	body->velocity[0] += body->acceleration[0];
+	body->velocity[1] += body->acceleration[1];
+
+	if (can_use_static_grid(body)) {
+		vec2 frame_velocity;
+		vec2_scale(frame_velocity, body->velocity, global.time.delta);
+		projectile_response(body, frame_velocity);
+		return;
+	}
+
+	vec2 scaled_velocity;
+	vec2_scale(scaled_velocity, body->velocity, global.time.delta * tick_rate);
+
+	for (u32 j = 0; j < iterations && body->is_active; ++j) {
+		sweep_response(body, scaled_velocity);
+		if (body->is_active) {
+			stationary_response(body);
 		}
 	}
+}
+
+void physics_update(void) {
+	Ecs_Query query = ecs_query(ECS_MASK(physics_components.body), 0);
+	Ecs_View view;
 
-	Body *body = physics_body_get(id);
+	while (ecs_query_next(&query, &view)) {
+		// Rows created by callbacks land after count, they start moving next frame.
+		Body *bodies = ecs_view_column(&view, physics_components.body);
+		usize count = view.count;
 
-	*body = (Body){
+		for (usize i = 0; i < count; ++i) {
+			body_update(&bodies[i]);
+		}
+	}
+}
+
+static u32 on_hit_id(On_Hit on_hit);
+static u32 on_hit_static_id(On_Hit_Static on_hit_static);
+
+Body physics_body_make(vec2 position, vec2 size, vec2 velocity, u8 collision_layer, u8 collision_mask, bool is_kinematic, On_Hit on_hit, On_Hit_Static on_hit_static) {
+	return (Body){
 		.aabb = {
 			.position = { position[0], position[1] },
 			.half_size = { size[0] * 0.5, size[1] * 0.5 },
@@ -333,18 +513,44 @@ usize physics_body_create(vec2 position, vec2 size, vec2 velocity, u8 collision_
 		.velocity = { velocity[0], velocity[1] },
 		.collision_layer = collision_layer,
 		.collision_mask = collision_mask,
-		.on_hit = on_hit,
-		.on_hit_static = on_hit_static,
+		.on_hit_id = on_hit_id(on_hit),
+		.on_hit_static_id = on_hit_static_id(on_hit_static),
 		.is_kinematic = is_kinematic,
 		.is_active = true,
-        .entity_id = entity_id
 	};
+}
+
+Body *physics_body_add(usize id, const Body *body) {
+	ecs_add(id, physics_components.body);
+
+	Body *added = ecs_get(id, physics_components.body);
+	if (!added) {
+		ERROR_RETURN(NULL, "Cannot add a body to dead entity %zu\n", id);
+	}
+	*added = *body;
+	added->id = id;
+
+	return added;
+}
+
+usize physics_body_create(vec2 position, vec2 size, vec2 velocity, u8 collision_layer, u8 collision_mask, bool is_kinematic, On_Hit on_hit, On_Hit_Static on_hit_static) {
+	Body body = physics_body_make(position, size, velocity, collision_layer, collision_mask, is_kinematic, on_hit, on_hit_static);
+	usize id = ecs_create(ECS_MASK(physics_components.body));
+	physics_body_add(id, &body);
 
 	return id;
 }
 
-Body *physics_body_get(usize index) {
-	return array_list_get(state.body_list, index);
+Body *physics_body_get(usize id) {
+	Body *body = ecs_get(id, physics_components.body);
+	if (!body) {
+		ERROR_RETURN(NULL, "Body %zu not found\n", id);
+	}
+	return body;
+}
+
+usize physics_body_count(void) {
+	return ecs_count(ECS_MASK(physics_components.body));
 }
 
 usize physics_static_body_create(vec2 position, vec2 size, u8 collision_layer) {
@@ -356,30 +562,514 @@ usize physics_static_body_create(vec2 position, vec2 size, u8 collision_layer) {
 		.collision_layer = collision_layer,
 	};
 
-	if (array_list_append(state.static_body_list, &static_body) == (usize)-1)
+	if (array_Static_Body_push(&state.static_body_list, static_body) == (usize)-1)
 		ERROR_EXIT("Could not append static body to list\n");
 
-	return state.static_body_list->len - 1;
+	state.static_grid.is_valid = false;
+
+	return state.static_body_list.len - 1;
 }
 
 usize physics_trigger_create(vec2 position, vec2 size, u8 collision_layer, u8 collision_mask, On_Hit on_hit) {
-    return physics_body_create(position, size, (vec2){0, 0}, collision_layer, collision_mask, true, on_hit, NULL, (usize)-1);
+    return physics_body_create(position, size, (vec2){0, 0}, collision_layer, collision_mask, true, on_hit, NULL);
 }
 
 Static_Body *physics_static_body_get(usize index) {
-	return array_list_get(state.static_body_list, index);
+	return array_Static_Body_try_get(&state.static_body_list, index);
 }
 
 usize physics_static_body_count() {
-    return state.static_body_list->len;
+    return state.static_body_list.len;
+}
+
+static int compare_f32(const void *a, const void *b) {
+	f32 x = *(const f32 *)a;
+	f32 y = *(const f32 *)b;
+	return (x > y) - (x < y);
+}
+
+// Sorts and removes duplicate edges, returns the new length.
+static usize unique_edges(f32 *edges, usize len) {
+	qsort(edges, len, sizeof(f32), compare_f32);
+
+	usize unique_len = 0;
+	for (usize i = 0; i < len; ++i) {
+		if (unique_len == 0 || edges[i] - edges[unique_len - 1] > COALESCE_EPSILON) {
+			edges[unique_len++] = edges[i];
+		}
+	}
+
+	return unique_len;
+}
+
+static usize find_edge(f32 *edges, usize len, f32 value) {
+	usize low = 0;
+	usize high = len - 1;
+
+	while (low < high) {
+		usize mid = (low + high) / 2;
+		if (edges[mid] < value - COALESCE_EPSILON) {
+			low = mid + 1;
+		} else {
+			high = mid;
+		}
+	}
+
+	return low;
+}
+
+// Greedy meshes every static on one layer over a grid made from their edges.
+// Returns the number of rects written to out, or -1 if it would not be fewer than count.
+static usize coalesce_layer(Static_Body *bodies, usize count, u8 collision_layer, Static_Body *out) {
+	f32 *xs = memory_alloc(sizeof(f32) * count * 2, MEMORY_TAG_PHYSICS);
+	f32 *ys = memory_alloc(sizeof(f32) * count * 2, MEMORY_TAG_PHYSICS);
+	if (!xs || !ys) {
+		ERROR_EXIT("Could not allocate memory for static body coalescing\n");
+	}
+
+	for (usize i = 0; i < count; ++i) {
+		vec2 min, max;
+		aabb_min_max(min, max, bodies[i].aabb);
+		xs[i * 2 + 0] = min[0];
+		xs[i * 2 + 1] = max[0];
+		ys[i * 2 + 0] = min[1];
+		ys[i * 2 + 1] = max[1];
+	}
+
+	usize x_len = unique_edges(xs, count * 2);
+	usize y_len = unique_edges(ys, count * 2);
+	usize columns = x_len - 1;
+	usize rows = y_len - 1;
+
+	// 1 = covered, 2 = covered and already emitted.
+	u8 *cells = memory_alloc(columns * rows, MEMORY_TAG_PHYSICS);
+	if (!cells) {
+		ERROR_EXIT("Could not allocate memory for static body coalescing\n");
+	}
+	memset(cells, 0, columns * rows);
+
+	for (usize i = 0; i < count; ++i) {
+		vec2 min, max;
+		aabb_min_max(min, max, bodies[i].aabb);
+		usize x0 = find_edge(xs, x_len, min[0]);
+		usize x1 = find_edge(xs, x_len, max[0]);
+		usize y0 = find_edge(ys, y_len, min[1]);
+		usize y1 = find_edge(ys, y_len, max[1]);
+
+		for (usize y = y0; y < y1; ++y) {
+			for (usize x = x0; x < x1; ++x) {
+				cells[y * columns + x] = 1;
+			}
+		}
+	}
+
+	usize out_len = 0;
+
+	for (usize y = 0; y < rows && out_len < count; ++y) {
+		for (usize x = 0; x < columns && out_len < count; ++x) {
+			if (cells[y * columns + x] != 1) {
+				continue;
+			}
+
+			usize w = 1;
+			while (x + w < columns && cells[y * columns + x + w] == 1) {
+				++w;
+			}
+
+			usize h = 1;
+			while (y + h < rows) {
+				bool is_row_covered = true;
+				for (usize i = 0; i < w; ++i) {
+					if (cells[(y + h) * columns + x + i] != 1) {
+						is_row_covered = false;
+						break;
+					}
+				}
+				if (!is_row_covered) {
+					break;
+				}
+				++h;
+			}
+
+			for (usize j = 0; j < h; ++j) {
+				for (usize i = 0; i < w; ++i) {
+					cells[(y + j) * columns + x + i] = 2;
+				}
+			}
+
+			f32 half_width = (xs[x + w] - xs[x]) * 0.5f;
+			f32 half_height = (ys[y + h] - ys[y]) * 0.5f;
+			out[out_len++] = (Static_Body){
+				.aabb = {
+					.position = { xs[x] + half_width, ys[y] + half_height },
+					.half_size = { half_width, half_height },
+				},
+				.collision_layer = collision_layer,
+			};
+		}
+	}
+
+	// Meshing overlapping shapes (e.g. a cross) can produce more rects than it started with.
+	bool is_smaller = out_len < count;
+	for (usize i = 0; i < rows * columns && is_smaller; ++i) {
+		if (cells[i] == 1) {
+			is_smaller = false;
+		}
+	}
+
+	memory_free(cells);
+	memory_free(xs);
+	memory_free(ys);
+
+	return is_smaller ? out_len : (usize)-1;
+}
+
+// Registers every static in each cell its AABB touches, grown by the largest
+// projectile half size so a projectile's center ray only has to visit its own cells.
+static void static_grid_build(void) {
+	Static_Grid *grid = &state.static_grid;
+	usize count = state.static_body_list.len;
+
+	memory_free(grid->cell_start);
+	memory_free(grid->cell_items);
+	grid->cell_start = NULL;
+	grid->cell_items = NULL;
+	grid->is_valid = false;
+
+	if (count == 0) {
+		return;
+	}
+
+	vec2 grid_min = { INFINITY, INFINITY };
+	vec2 grid_max = { -INFINITY, -INFINITY };
+	for (usize i = 0; i < count; ++i) {
+		vec2 min, max;
+		aabb_min_max(min, max, physics_static_body_get(i)->aabb);
+		for (u8 j = 0; j < 2; ++j) {
+			grid_min[j] = fminf(grid_min[j], min[j] - PHYSICS_PROJECTILE_MAX_HALF_SIZE);
+			grid_max[j] = fmaxf(grid_max[j], max[j] + PHYSICS_PROJECTILE_MAX_HALF_SIZE);
+		}
+	}
+
+	grid->cell_size = STATIC_GRID_CELL_SIZE;
+	do {
+		grid->columns = (u32)ceilf((grid_max[0] - grid_min[0]) / grid->cell_size);
+		grid->rows = (u32)ceilf((grid_max[1] - grid_min[1]) / grid->cell_size);
+		if (grid->columns == 0) grid->columns = 1;
+		if (grid->rows == 0) grid->rows = 1;
+		if ((usize)grid->columns * grid->rows <= STATIC_GRID_MAX_CELLS) {
+			break;
+		}
+		grid->cell_size *= 2;
+	} while (true);
+
+	grid->origin[0] = grid_min[0];
+	grid->origin[1] = grid_min[1];
+
+	usize cell_count = (usize)grid->columns * grid->rows;
+	grid->cell_start = memory_alloc(sizeof(u32) * (cell_count + 1), MEMORY_TAG_PHYSICS);
+	if (!grid->cell_start) {
+		ERROR_EXIT("Could not allocate memory for static grid\n");
+	}
+	memset(grid->cell_start, 0, sizeof(u32) * (cell_count + 1));
+
+	// First pass counts ids per cell, second pass fills them in.
+	for (u8 pass = 0; pass < 2; ++pass) {
+		for (usize i = 0; i < count; ++i) {
+			vec2 min, max;
+			aabb_min_max(min, max, physics_static_body_get(i)->aabb);
+			u32 x0 = (u32)((min[0] - PHYSICS_PROJECTILE_MAX_HALF_SIZE - grid->origin[0]) / grid->cell_size);
+			u32 y0 = (u32)((min[1] - PHYSICS_PROJECTILE_MAX_HALF_SIZE - grid->origin[1]) / grid->cell_size);
+			u32 x1 = (u32)((max[0] + PHYSICS_PROJECTILE_MAX_HALF_SIZE - grid->origin[0]) / grid->cell_size);
+			u32 y1 = (u32)((max[1] + PHYSICS_PROJECTILE_MAX_HALF_SIZE - grid->origin[1]) / grid->cell_size);
+			if (x1 >= grid->columns) x1 = grid->columns - 1;
+			if (y1 >= grid->rows) y1 = grid->rows - 1;
+
+			for (u32 y = y0; y <= y1; ++y) {
+				for (u32 x = x0; x <= x1; ++x) {
+					u32 index = y * grid->columns + x;
+					if (pass == 0) {
+						++grid->cell_start[index + 1];
+					} else {
+						grid->cell_items[grid->cell_start[index]++] = (u32)i;
+					}
+				}
+			}
+		}
+
+		if (pass == 0) {
+			for (usize j = 0; j < cell_count; ++j) {
+				grid->cell_start[j + 1] += grid->cell_start[j];
+			}
+			grid->cell_items = memory_alloc(sizeof(u32) * grid->cell_start[cell_count], MEMORY_TAG_PHYSICS);
+			if (!grid->cell_items) {
+				ERROR_EXIT("Could not allocate memory for static grid\n");
+			}
+		}
+	}
+
+	// The fill pass advanced every start to the next cell's start, shift them back.
+	for (usize j = cell_count; j > 0; --j) {
+		grid->cell_start[j] = grid->cell_start[j - 1];
+	}
+	grid->cell_start[0] = 0;
+
+	grid->is_valid = true;
+}
+
+void physics_static_body_finalize(void) {
+	usize before = state.static_body_list.len;
+	if (before < 2) {
+		static_grid_build();
+		return;
+	}
+
+	Static_Body *bodies = memory_alloc(sizeof(Static_Body) * before, MEMORY_TAG_PHYSICS);
+	Static_Body *layer_bodies = memory_alloc(sizeof(Static_Body) * before, MEMORY_TAG_PHYSICS);
+	Static_Body *merged = memory_alloc(sizeof(Static_Body) * before, MEMORY_TAG_PHYSICS);
+	if (!bodies || !layer_bodies || !merged) {
+		ERROR_EXIT("Could not allocate memory for static body coalescing\n");
+	}
+	memcpy(bodies, state.static_body_list.items, sizeof(Static_Body) * before);
+
+	state.static_body_list.len = 0;
+
+	bool is_layer_done[256] = {0};
+
+	for (usize i = 0; i < before; ++i) {
+		u8 collision_layer = bodies[i].collision_layer;
+		if (is_layer_done[collision_layer]) {
+			continue;
+		}
+		is_layer_done[collision_layer] = true;
+
+		usize layer_count = 0;
+		for (usize j = i; j < before; ++j) {
+			if (bodies[j].collision_layer == collision_layer) {
+				layer_bodies[layer_count++] = bodies[j];
+			}
+		}
+
+		usize merged_count = layer_count > 1 ? coalesce_layer(layer_bodies, layer_count, collision_layer, merged) : (usize)-1;
+		Static_Body *result = merged;
+		if (merged_count == (usize)-1) {
+			result = layer_bodies;
+			merged_count = layer_count;
+		}
+
+		for (usize j = 0; j < merged_count; ++j) {
+			if (array_Static_Body_push(&state.static_body_list, result[j]) == (usize)-1) {
+				ERROR_EXIT("Could not append static body to list\n");
+			}
+		}
+	}
+
+	memory_free(bodies);
+	memory_free(layer_bodies);
+	memory_free(merged);
+
+	printf("Static bodies coalesced: %zu -> %zu\n", before, state.static_body_list.len);
+
+	static_grid_build();
 }
 
 void physics_reset(void) {
-    state.static_body_list->len = 0;
-    state.body_list->len = 0;
+	state.static_body_list.len = 0;
+	state.static_grid.is_valid = false;
 }
 
 void physics_body_destroy(usize body_id) {
-    Body *body = physics_body_get(body_id);
-    body->is_active = false;
-}
\ No newline at end of file
+	if (!ecs_has(body_id, physics_components.body)) {
+		return;
+	}
+
+	if (on_body_destroy) {
+		on_body_destroy(body_id);
+	}
+
+	ecs_destroy(body_id);
+}
+
+void physics_on_body_destroy_set(On_Body_Destroy callback) {
+	on_body_destroy = callback;
+}
+u32 physics_on_hit_register(On_Hit on_hit) {
+	if (array_On_Hit_push(&on_hit_registry, on_hit) == (usize)-1) {
+		ERROR_EXIT("Could not register on_hit callback\n");
+	}
+	return (u32)on_hit_registry.len;
+}
+
+u32 physics_on_hit_static_register(On_Hit_Static on_hit_static) {
+	if (array_On_Hit_Static_push(&on_hit_static_registry, on_hit_static) == (usize)-1) {
+		ERROR_EXIT("Could not register on_hit_static callback\n");
+	}
+	return (u32)on_hit_static_registry.len;
+}
+
+// Linear, there are only a handful of callbacks.
+static u32 on_hit_id(On_Hit on_hit) {
+	if (!on_hit) {
+		return 0;
+	}
+	for (usize i = 0; i < on_hit_registry.len; ++i) {
+		if (on_hit_registry.items[i] == on_hit) {
+			return (u32)i + 1;
+		}
+	}
+	ERROR_EXIT("Body uses an unregistered on_hit callback\n");
+}
+
+static u32 on_hit_static_id(On_Hit_Static on_hit_static) {
+	if (!on_hit_static) {
+		return 0;
+	}
+	for (usize i = 0; i < on_hit_static_registry.len; ++i) {
+		if (on_hit_static_registry.items[i] == on_hit_static) {
+			return (u32)i + 1;
+		}
+	}
+	ERROR_EXIT("Body uses an unregistered on_hit_static callback\n");
+}
+
+u64 physics_snapshot_write(Blob_Writer *writer) {
+	Static_Grid *grid = &state.static_grid;
+	usize cell_count = grid->is_valid ? (usize)grid->columns * grid->rows + 1 : 0;
+	usize cell_item_count = grid->is_valid ? grid->cell_start[cell_count - 1] : 0;
+
+	u64 offset = blob_reserve(writer, sizeof(Physics_Snapshot));
+	Physics_Snapshot snapshot = {
+		.static_body_count = state.static_body_list.len,
+		.static_bodies = blob_write(writer, state.static_body_list.items, sizeof(Static_Body) * state.static_body_list.len),
+		.grid_origin = { grid->origin[0], grid->origin[1] },
+		.grid_cell_size = grid->cell_size,
+		.grid_columns = grid->columns,
+		.grid_rows = grid->rows,
+		.grid_is_valid = grid->is_valid,
+		.grid_cell_start = blob_write(writer, grid->cell_start, sizeof(u32) * cell_count),
+		.grid_cell_item_count = cell_item_count,
+		.grid_cell_items = blob_write(writer, grid->cell_items, sizeof(u32) * cell_item_count),
+	};
+
+	if (writer->data) {
+		memcpy(blob_ptr(writer, offset), &snapshot, sizeof(Physics_Snapshot));
+	}
+
+	return offset;
+}
+
+// Sections of a snapshot header, NULL for any that does not fit in the blob.
+typedef struct physics_snapshot_sections {
+	const Static_Body *static_bodies;
+	const u32 *cell_start;
+	const u32 *cell_items;
+	u64 cell_count;
+} Physics_Snapshot_Sections;
+
+static Physics_Snapshot_Sections physics_snapshot_sections(const u8 *data, usize len, const Physics_Snapshot *snapshot) {
+	// u64 so a crafted column and row count cannot wrap.
+	u64 cell_count = snapshot->grid_is_valid ? (u64)snapshot->grid_columns * snapshot->grid_rows + 1 : 0;
+	return (Physics_Snapshot_Sections){
+		.static_bodies = blob_array(data, len, snapshot->static_bodies, snapshot->static_body_count, sizeof(Static_Body)),
+		.cell_start = blob_array(data, len, snapshot->grid_cell_start, cell_count, sizeof(u32)),
+		.cell_items = blob_array(data, len, snapshot->grid_cell_items, snapshot->grid_cell_item_count, sizeof(u32)),
+		.cell_count = cell_count,
+	};
+}
+
+static bool physics_snapshot_validate_grid(const Physics_Snapshot *snapshot, const Physics_Snapshot_Sections *sections) {
+	if (!snapshot->grid_is_valid) {
+		return true;
+	}
+
+	// Same limits static_grid_build keeps, the raycast walks cells with i32 and u32 indices.
+	if (snapshot->grid_columns == 0 || snapshot->grid_rows == 0 || sections->cell_count - 1 > STATIC_GRID_MAX_CELLS || !(snapshot->grid_cell_size > 0)) {
+		ERROR_RETURN(false, "Physics snapshot static grid has a bad size\n");
+	}
+
+	// Cell ranges must be ordered and end at the item count, raycasts index cell_items with them.
+	if (sections->cell_start[0] != 0 || sections->cell_start[sections->cell_count - 1] != snapshot->grid_cell_item_count) {
+		ERROR_RETURN(false, "Physics snapshot static grid cells do not cover its items\n");
+	}
+	for (u64 i = 1; i < sections->cell_count; ++i) {
+		if (sections->cell_start[i] < sections->cell_start[i - 1]) {
+			ERROR_RETURN(false, "Physics snapshot static grid cell %llu starts before the previous one\n", (unsigned long long)i);
+		}
+	}
+	for (u64 i = 0; i < snapshot->grid_cell_item_count; ++i) {
+		if (sections->cell_items[i] >= snapshot->static_body_count) {
+			ERROR_RETURN(false, "Physics snapshot static grid refers to static body %u of %llu\n", sections->cell_items[i], (unsigned long long)snapshot->static_body_count);
+		}
+	}
+
+	return true;
+}
+
+bool physics_snapshot_validate(const u8 *data, usize len, u64 offset) {
+	const Physics_Snapshot *snapshot = blob_at(data, len, offset, sizeof(Physics_Snapshot));
+	if (!snapshot) {
+		ERROR_RETURN(false, "Physics snapshot header out of range\n");
+	}
+
+	Physics_Snapshot_Sections sections = physics_snapshot_sections(data, len, snapshot);
+	if (!sections.static_bodies || !sections.cell_start || !sections.cell_items) {
+		ERROR_RETURN(false, "Physics snapshot section out of range\n");
+	}
+
+	return physics_snapshot_validate_grid(snapshot, &sections);
+}
+
+bool physics_snapshot_check_chunk(Ecs_Mask mask, Ecs_View *view) {
+	if (!(mask & ECS_MASK(physics_components.body))) {
+		return true;
+	}
+
+	// Callbacks are called through the registry by id, entity code trusts a body's id.
+	Body *bodies = ecs_view_column(view, physics_components.body);
+	for (usize i = 0; i < view->count; ++i) {
+		if (bodies[i].id != view->entity_ids[i]) {
+			ERROR_RETURN(false, "Physics snapshot body %zu is stored in the row of %zu\n", bodies[i].id, view->entity_ids[i]);
+		}
+		if (!blob_bool_is_valid(&bodies[i].is_kinematic) || !blob_bool_is_valid(&bodies[i].is_active) || !blob_bool_is_valid(&bodies[i].is_projectile)) {
+			ERROR_RETURN(false, "Physics snapshot body %zu has a bad flag\n", bodies[i].id);
+		}
+		if (bodies[i].on_hit_id > on_hit_registry.len || bodies[i].on_hit_static_id > on_hit_static_registry.len) {
+			ERROR_RETURN(false, "Physics snapshot uses an unregistered callback\n");
+		}
+	}
+
+	return true;
+}
+
+void physics_snapshot_read(const u8 *data, usize len, u64 offset) {
+	const Physics_Snapshot *snapshot = blob_at(data, len, offset, sizeof(Physics_Snapshot));
+	Physics_Snapshot_Sections sections = physics_snapshot_sections(data, len, snapshot);
+	usize cell_count = sections.cell_count;
+
+	physics_reset();
+
+	if (!array_Static_Body_assign(&state.static_body_list, sections.static_bodies, snapshot->static_body_count)) {
+		ERROR_EXIT("Could not allocate memory for physics snapshot\n");
+	}
+
+	Static_Grid *grid = &state.static_grid;
+	memory_free(grid->cell_start);
+	memory_free(grid->cell_items);
+	*grid = (Static_Grid){
+		.origin = { snapshot->grid_origin[0], snapshot->grid_origin[1] },
+		.cell_size = snapshot->grid_cell_size,
+		.columns = snapshot->grid_columns,
+		.rows = snapshot->grid_rows,
+	};
+
+	if (snapshot->grid_is_valid) {
+		grid->cell_start = memory_alloc(sizeof(u32) * cell_count, MEMORY_TAG_PHYSICS);
+		grid->cell_items = memory_alloc(sizeof(u32) * snapshot->grid_cell_item_count, MEMORY_TAG_PHYSICS);
+		if (!grid->cell_start || !grid->cell_items) {
+			ERROR_EXIT("Could not allocate memory for static grid\n");
+		}
+		memcpy(grid->cell_start, sections.cell_start, sizeof(u32) * cell_count);
+		memcpy(grid->cell_items, sections.cell_items, sizeof(u32) * snapshot->grid_cell_item_count);
+		grid->is_valid = true;
+	}
+}
@@ -3,6 +3,10 @@
 #include <stdbool.h>
 #include <linmath.h>
 #include "../types.h"
+#include "../io/blob.h"
+#include "../ecs/ecs.h"
+
+#define PHYSICS_PROJECTILE_MAX_HALF_SIZE 8
 
 typedef struct hit Hit;
 typedef struct body Body;
@@ -10,23 +14,30 @@ typedef struct static_body Static_Body;
 
 typedef void (*On_Hit)(Body *self, Body *other, Hit hit);
 typedef void (*On_Hit_Static)(Body *self, Static_Body *other, Hit hit);
+typedef void (*On_Body_Destroy)(usize body_id);
 
 typedef struct aabb {
 	vec2 position;
 	vec2 half_size;
 } AABB;
 
+// Bodies are rows of the body ECS component, so an entity's body shares its row and id.
+// Callbacks are kept as registered ids, 0 is none, which leaves bodies plain data that
+// ECS chunks and snapshots can copy as-is.
 struct body {
 	AABB aabb;
 	vec2 velocity;
 	vec2 acceleration;
-	On_Hit on_hit;
-	On_Hit_Static on_hit_static;
-    usize entity_id;
+	usize id;
+	u32 on_hit_id;
+	u32 on_hit_static_id;
 	u8 collision_layer;
 	u8 collision_mask;
 	bool is_kinematic;
 	bool is_active;
+	// Moves once per frame by a grid raycast against statics instead of the iterative sweep.
+	// Only used when both half sizes are at most PHYSICS_PROJECTILE_MAX_HALF_SIZE.
+	bool is_projectile;
 };
 
 struct static_body {
@@ -42,20 +53,64 @@ struct hit {
 	bool is_hit;
 };
 
+typedef struct physics_components {
+	u32 body;
+} Physics_Components;
+
+extern Physics_Components physics_components;
+
+// Call after ecs_init, registers the body component.
 void physics_init(void);
+// Steps every active body as a query over the body component. Callbacks may create bodies, new rows
+// are appended without moving the ones being stepped, but structural changes that move rows have
+// to wait for the frame's sync point (see entity_command_destroy).
 void physics_update(void);
-usize physics_body_create(vec2 position, vec2 size, vec2 velocity, u8 collision_layer, u8 collision_mask, bool is_kinematic, On_Hit on_hit, On_Hit_Static on_hit_static, usize entity_id);
+// An active body value for physics_body_add or a prefab. Callbacks must be registered first.
+Body physics_body_make(vec2 position, vec2 size, vec2 velocity, u8 collision_layer, u8 collision_mask, bool is_kinematic, On_Hit on_hit, On_Hit_Static on_hit_static);
+// Gives the ECS entity id a copy of body with its id set, returns NULL for dead ids.
+Body *physics_body_add(usize id, const Body *body);
+// Creates an ECS entity holding only a body, e.g. a trigger.
+usize physics_body_create(vec2 position, vec2 size, vec2 velocity, u8 collision_layer, u8 collision_mask, bool is_kinematic, On_Hit on_hit, On_Hit_Static on_hit_static);
 usize physics_trigger_create(vec2 position, vec2 size, u8 collision_layer, u8 collision_mask, On_Hit on_hit);
-Body *physics_body_get(usize index);
+// NULL if the id is not a live body. Valid until the next ECS destroy or component change.
+Body *physics_body_get(usize id);
+usize physics_body_count(void);
+// NULL if index is out of range.
 Static_Body *physics_static_body_get(usize index);
 usize physics_static_body_count();
 usize physics_static_body_create(vec2 position, vec2 size, u8 collision_layer);
+// Call once all statics for a level are created. Merges touching statics on the same
+// layer into as few rects as possible, so static body ids are not stable across it,
+// then builds the grid used by projectile bodies.
+void physics_static_body_finalize(void);
 bool physics_point_intersect_aabb(vec2 point, AABB aabb);
 bool physics_aabb_intersect_aabb(AABB a, AABB b);
 AABB aabb_minkowski_difference(AABB a, AABB b);
 void aabb_penetration_vector(vec2 r, AABB aabb);
 void aabb_min_max(vec2 min, vec2 max, AABB aabb);
 Hit ray_intersect_aabb(vec2 position, vec2 magnitude, AABB aabb);
+// Clears statics and the static grid. Bodies are ECS rows and go with ecs_clear.
 void physics_reset(void);
 
-void physics_body_destroy(usize body_id);
\ No newline at end of file
+// Destroys the ECS entity holding the body, which moves another row into its place, so it
+// must not run inside physics_update.
+void physics_body_destroy(usize body_id);
+// Called by physics_body_destroy while the id is still valid, so systems keyed by the id can
+// drop it before the id is reused. The entity module sets this in entity_init.
+void physics_on_body_destroy_set(On_Body_Destroy callback);
+
+// Bodies store callbacks as registered ids, 0 is NULL. Register every callback before creating
+// bodies that use it, in the same order on every run so saved ids keep their meaning.
+u32 physics_on_hit_register(On_Hit on_hit);
+u32 physics_on_hit_static_register(On_Hit_Static on_hit_static);
+// Writes statics and the static grid as flat arrays, returns the offset of the section header.
+// Bodies are saved with the ECS section.
+u64 physics_snapshot_write(Blob_Writer *writer);
+// Checks the section at offset without touching the world: every count against the blob and
+// every grid index against the statics it points into.
+bool physics_snapshot_validate(const u8 *data, usize len, u64 offset);
+// ecs_snapshot_validate check for saved chunks holding bodies: each body carries its row's id
+// and only registered callback ids.
+bool physics_snapshot_check_chunk(Ecs_Mask mask, Ecs_View *view);
+// Replaces statics and the static grid with a section that passed physics_snapshot_validate.
+void physics_snapshot_read(const u8 *data, usize len, u64 offset);
\ No newline at end of file
@@ -1,11 +1,29 @@
 #pragma once
 
-#include "../array_list/array_list.h"
+#include <stdbool.h>
+#include <linmath.h>
+
+#include "../array_list/array.h"
 #include "../types.h"
+#include "physics.h"
+
+DEFINE_ARRAY(Static_Body)
+
+// Uniform grid over the static bodies, stored as one flat id array per cell
+// (cell_start[i] .. cell_start[i + 1] indexes into cell_items).
+typedef struct static_grid {
+	vec2 origin;
+	f32 cell_size;
+	u32 columns;
+	u32 rows;
+	u32 *cell_start;
+	u32 *cell_items;
+	bool is_valid;
+}Static_Grid;
 
 typedef struct physics_state_internal {
 	f32 gravity;
 	f32 terminal_velocity;
-	Array_List* body_list;
-	Array_List* static_body_list;
+	Array_Static_Body static_body_list;
+	Static_Grid static_grid;
 }Physics_State_Internal;
\ No newline at end of file
@@ -1,13 +1,17 @@
 #include <glad/glad.h>
 
+#include "../memory/memory.h"
+
 #define STB_IMAGE_IMPLEMENTATION
+#define STBI_MALLOC(size) memory_alloc(size, MEMORY_TAG_ASSET)
+#define STBI_REALLOC(ptr, size) memory_realloc(ptr, size, MEMORY_TAG_ASSET)
+#define STBI_FREE(ptr) memory_free(ptr)
 #include <stb_image.h>
 
 #include "../global.h"
 #include "render.h"
 #include "render_internal.h"
 #include "../util.h"
-#include "../array_list/array_list.h"
 
 static f32 window_width = 1920;
 static f32 window_height = 1080;
@@ -20,79 +24,139 @@ static u32 vao_quad;
 static u32 vbo_quad;
 static u32 ebo_quad;
 
-static u32 vao_line;
-static u32 vbo_line;
-
 static u32 shader_default;
+// Looked up once at init, not on every draw.
+static i32 uniform_default_model;
+static i32 uniform_default_color;
 static u32 texture_color;
 
+#if RENDER_SPRITE_INSTANCING
+// One per stream segment, GL 3.3 has no base instance so each points its attributes at its own segment.
+static u32 vao_batch_segments[RENDER_STREAM_SEGMENTS];
+#else
 static u32 vao_batch;
-static u32 vbo_batch;
 static u32 ebo_batch;
+// GL_UNSIGNED_SHORT when a segment's vertices fit in u16, indices are segment relative.
+static u32 batch_index_type;
+#endif
+static u32 vbo_batch;
 
 static u32 shader_batch;
-static Array_List *list_batch;
-
-static i32 find_texture_slot(u32 texture_slots[8], u32 texture_id) {
-    for (i32 i = 1; i < 8; ++i) {
-        if (texture_slots[i] == texture_id) {
-            return i;
-        }
-    }
+static usize batch_quad_capacity;
+// Texture array the batched sprites sample, 0 while the batch is empty.
+static u32 batch_texture_id;
+static u32 flush_count;
+static u32 last_flush_count;
+static u32 last_state_calls_avoided;
+
+// Bytes one quad takes in the stream, a Sprite_Instance or 4 Batch_Vertex.
+static usize stream_quad_size;
+// Whole vbo when it is persistently mapped, NULL when each segment is mapped on first use.
+static u8 *stream_mapped;
+// Segment being filled, its memory and how many quads are written. data is NULL until it is mapped.
+static u32 stream_segment;
+static u8 *stream_data;
+static usize stream_count;
+// Signalled once the GPU is done with the draw that read each segment.
+static GLsync stream_fences[RENDER_STREAM_SEGMENTS];
+
+// Waits until the GPU no longer reads the current segment, then points stream_data at it.
+static void stream_segment_begin(void) {
+	GLsync fence = stream_fences[stream_segment];
+	if(fence) {
+		GLenum status;
+		do {
+			status = glClientWaitSync(fence,GL_SYNC_FLUSH_COMMANDS_BIT,1000000000);
+		} while(status == GL_TIMEOUT_EXPIRED);
+		glDeleteSync(fence);
+		stream_fences[stream_segment] = NULL;
+	}
 
-    return -1;
+	usize segment_size = batch_quad_capacity * stream_quad_size;
+	if(stream_mapped) {
+		stream_data = stream_mapped + stream_segment * segment_size;
+	} else {
+		// The fence already orders us after the GPU, the driver need not sync again.
+		render_state_bind_array_buffer(vbo_batch);
+		stream_data = glMapBufferRange(
+			GL_ARRAY_BUFFER,
+			stream_segment * segment_size,
+			segment_size,
+			GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT
+		);
+		if(!stream_data) {
+			ERROR_EXIT("Could not map batch stream segment\n");
+		}
+	}
+	stream_count = 0;
 }
 
-static i32 try_insert_texture(u32 texture_slots[8], u32 texture_id) {
-    i32 index = find_texture_slot(texture_slots, texture_id);
-    if (index > 0) {
-        return index;
-    }
-
-    for (i32 i = 1; i < 8; ++i) {
-        if (texture_slots[i] == 0) {
-            texture_slots[i] = texture_id;
-            return i;
-        }
-    }
-
-    return -1;
+// The caller makes room first, see render_sprite_sheet_frame. Written straight into the mapped buffer.
+static void* stream_push_quad(void) {
+	if(!stream_data) {
+		stream_segment_begin();
+	}
+	return stream_data + stream_quad_size * stream_count++;
 }
 
-static void render_batch(Batch_Vertex *vertices,usize count,u32 texture_ids[8]) {
-	glBindBuffer(GL_ARRAY_BUFFER,vbo_batch);
-	glBufferSubData(GL_ARRAY_BUFFER,0, count *sizeof(Batch_Vertex),vertices);
-
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D,texture_color);
+static void render_batch(usize count,u32 texture_id) {
+	if(!stream_mapped) {
+		render_state_bind_array_buffer(vbo_batch);
+		glUnmapBuffer(GL_ARRAY_BUFFER);
+	}
 
-	for (u32 i = 1; i < 8; ++i) {
-        glActiveTexture(GL_TEXTURE0 + i);
-        glBindTexture(GL_TEXTURE_2D, texture_ids[i]);
-    }
+	render_state_bind_texture(0, GL_TEXTURE_2D_ARRAY, texture_id);
 
+	render_state_use_program(shader_batch);
 
-	glUseProgram(shader_batch);
-	glBindVertexArray(vao_batch);
+#if RENDER_SPRITE_INSTANCING
+	render_state_bind_vertex_array(vao_batch_segments[stream_segment]);
+	glDrawArraysInstanced(GL_TRIANGLE_STRIP,0,4,(GLsizei)count);
+#else
+	render_state_bind_vertex_array(vao_batch);
+	// The index buffer counts from 0, base vertex moves it to this segment.
+	glDrawElementsBaseVertex(GL_TRIANGLES,count * 6,batch_index_type,NULL,(GLint)(stream_segment * batch_quad_capacity * 4));
+#endif
+	stream_fences[stream_segment] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE,0);
+	++flush_count;
+}
 
-	glDrawElements(GL_TRIANGLES,(count>>2) * 6,GL_UNSIGNED_INT,NULL);
+// Draws what is batched so far and moves to the next segment, the next sprite may bind any texture array.
+static void batch_flush(void) {
+	if(stream_count > 0) {
+		render_batch(stream_count,batch_texture_id);
+		stream_segment = (stream_segment + 1) % RENDER_STREAM_SEGMENTS;
+		stream_data = NULL;
+		stream_count = 0;
+	}
+	batch_texture_id = 0;
 }
 
-SDL_Window* render_init(void) {
+SDL_Window* render_init(u32 quad_capacity) {
 	window_width = 1920;
 	window_height = 1080;
 	SDL_Window* window = render_init_window(window_width, window_height);
 
+	if(quad_capacity == 0) {
+		quad_capacity = DEFAULT_BATCH_QUADS;
+	}
+	batch_quad_capacity = quad_capacity;
+
 	render_init_quad(&vao_quad, &vbo_quad, &ebo_quad);
-	render_init_batch_quads(&vao_batch,&vbo_batch,&ebo_batch);
-	render_init_line(&vao_line, &vbo_line);
+#if RENDER_SPRITE_INSTANCING
+	stream_quad_size = sizeof(Sprite_Instance);
+	stream_mapped = render_init_batch_instances(vao_batch_segments,&vbo_batch,quad_capacity);
+#else
+	stream_quad_size = 4 * sizeof(Batch_Vertex);
+	stream_mapped = render_init_batch_quads(&vao_batch,&vbo_batch,&ebo_batch,&batch_index_type,quad_capacity);
+#endif
 	render_init_shaders(&shader_default,&shader_batch,render_width,render_height);
+	uniform_default_model = glGetUniformLocation(shader_default, "model");
+	uniform_default_color = glGetUniformLocation(shader_default, "color");
 	render_init_color_texture(&texture_color);
+	render_debug_init(render_width,render_height);
 
-	glEnable(GL_BLEND);
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-
-	list_batch = array_list_create(sizeof(Batch_Vertex),8);
+	render_state_set_blend(true, GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
 
 	stbi_set_flip_vertically_on_load(1);
@@ -103,11 +167,15 @@ void render_begin(void) {
 	glClearColor(0.08, 0.1, 0.1, 1);
 	glClear(GL_COLOR_BUFFER_BIT);
 
-	list_batch->len =0;
+	batch_texture_id = 0;
+	flush_count = 0;
 }
 
-void render_end(SDL_Window* window, u32 batch_texture_ids[8]) {
-	render_batch(list_batch->items,list_batch->len,batch_texture_ids);
+void render_end(SDL_Window* window) {
+	batch_flush();
+	render_debug_flush();
+	last_flush_count = flush_count;
+	last_state_calls_avoided = render_state_take_calls_avoided();
 	SDL_GL_SwapWindow(window);
 }
 
@@ -115,10 +183,18 @@ f32 render_get_scale(void) {
 	return scale;
 }
 
+u32 render_get_flush_count(void) {
+	return last_flush_count;
+}
+
+u32 render_get_state_calls_avoided(void) {
+	return last_state_calls_avoided;
+}
+
 
 
 void render_quad(vec2 pos, vec2 size, vec4 color) {
-	glUseProgram(shader_default);
+	render_state_use_program(shader_default);
 
 	mat4x4 model;
 	mat4x4_identity(model);
@@ -126,151 +202,137 @@ void render_quad(vec2 pos, vec2 size, vec4 color) {
 	mat4x4_scale_aniso(model,model,size[0],size[1],1);
 
 	glUniformMatrix4fv(
-		glGetUniformLocation(shader_default, "model"),
+		uniform_default_model,
 		1, 
 		GL_FALSE, 
 		&model[0][0]
 	);
-	glUniform4fv( glGetUniformLocation( shader_default, "color" ), 1, color );
+	glUniform4fv( uniform_default_color, 1, color );
 
-	glBindVertexArray(vao_quad);
+	render_state_bind_vertex_array(vao_quad);
 
 	//glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-	glBindTexture(GL_TEXTURE_2D, texture_color);
+	render_state_bind_texture(0, GL_TEXTURE_2D, texture_color);
 	glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, NULL);
-
-	glBindVertexArray(0);
 }
 
-void render_line_segment(vec2 start, vec2 end, vec4 color) {
-	glUseProgram(shader_default);
-	glLineWidth(3);
-
-	f32 x = end[0] - start[0];
-	f32 y = end[1] - start[1];
-	f32 line[6] = { 0,0,0,x,y,0 };
-
-	mat4x4 model;
-	mat4x4_translate(model, start[0], start[1], 0);
-
-	glUniformMatrix4fv(glGetUniformLocation(shader_default, "model"), 1, GL_FALSE, &model[0][0]);
-	glUniform4fv(glGetUniformLocation(shader_default, "color"), 1, color);
-
-	glBindTexture(GL_TEXTURE_2D, texture_color);
-	glBindVertexArray(vao_line);
-
-	glBindBuffer(GL_ARRAY_BUFFER, vbo_line);
-	glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(line),line);
-
-	glDrawArrays(GL_LINES,0,2);
-
-	glBindVertexArray(0);
+static u16 quantize_unorm16(f32 value) {
+	value = value < 0 ? 0 : value > 1 ? 1 : value;
+	return (u16)(value * 65535.0f + 0.5f);
 }
 
-void render_quad_line(vec2 pos, vec2 size, vec4 color) {
-	vec2 points[4] = {
-	pos[0] - size[0] * 0.5, pos[1] - size[1] * 0.5,
-	pos[0] + size[0] * 0.5, pos[1] - size[1] * 0.5,
-	pos[0] + size[0] * 0.5, pos[1] + size[1] * 0.5,
-	pos[0] - size[0] * 0.5, pos[1] + size[1] * 0.5,
-	};
-
-	render_line_segment(points[0], points[1], color);
-	render_line_segment(points[1], points[2], color);
-	render_line_segment(points[2], points[3], color);
-	render_line_segment(points[3], points[0], color);
+static u8 quantize_unorm8(f32 value) {
+	value = value < 0 ? 0 : value > 1 ? 1 : value;
+	return (u8)(value * 255.0f + 0.5f);
 }
 
-void render_aabb(f32* aabb, vec4 color) {
-	vec2 size;
-	vec2_scale(size,&aabb[2],2);
-	render_quad_line(&aabb[0], size, color);
+#if RENDER_SPRITE_INSTANCING
+// One instance per sprite, the vertex shader expands it into a quad.
+static void append_instance(vec2 center, vec2 size, vec4 uvs, vec4 color, u32 texture_layer, bool is_flipped) {
+	Sprite_Instance *instance = stream_push_quad();
+	instance->position[0] = center[0];
+	instance->position[1] = center[1];
+	instance->size[0] = size[0];
+	instance->size[1] = size[1];
+	for(u32 i = 0;i < 4;++i) {
+		instance->uvs[i] = quantize_unorm16(uvs[i]);
+		instance->color[i] = quantize_unorm8(color[i]);
+	}
+	instance->texture_layer = (u16)texture_layer;
+	instance->flags = is_flipped ? SPRITE_INSTANCE_FLIPPED : 0;
 }
-
-static void append_quad(vec2 position, vec2 size, vec4 texture_coordinates, vec4 color, f32 texture_slot) {
+#else
+static void append_quad(vec2 position, vec2 size, vec4 texture_coordinates, vec4 color, u32 texture_layer) {
 	vec4 uvs = {0,0,1,1};
 	if(texture_coordinates != NULL) {
 		memcpy(uvs,texture_coordinates,sizeof(vec4));
 	}
 
-	array_list_append(list_batch,&(Batch_Vertex){
-		.position = {position[0],position[1]},
-		.uvs = {uvs[0],uvs[1]},
-		.color = {color[0],color[1],color[2],color[3]},
-		.texture_slot = texture_slot,
-	});
-	array_list_append(list_batch,&(Batch_Vertex){
-		.position = {position[0] + size[0],position[1]},
-		.uvs = {uvs[2],uvs[1]},
-		.color = {color[0],color[1],color[2],color[3]},
-		.texture_slot = texture_slot,
-	});
-	array_list_append(list_batch,&(Batch_Vertex){
-		.position = {position[0]+ size[0],position[1]+ size[1]},
-		.uvs = {uvs[2],uvs[3]},
-		.color = {color[0],color[1],color[2],color[3]},
-		.texture_slot = texture_slot,
-	});
-	array_list_append(list_batch,&(Batch_Vertex){
-		.position = {position[0],position[1]+ size[1]},
-		.uvs = {uvs[0],uvs[3]},
-		.color = {color[0],color[1],color[2],color[3]},
-		.texture_slot = texture_slot,
-	});
+	Batch_Vertex *vertices = stream_push_quad();
+
+	f32 x[4] = {position[0],position[0] + size[0],position[0] + size[0],position[0]};
+	f32 y[4] = {position[1],position[1],position[1] + size[1],position[1] + size[1]};
+	f32 u[4] = {uvs[0],uvs[2],uvs[2],uvs[0]};
+	f32 v[4] = {uvs[1],uvs[1],uvs[3],uvs[3]};
+
+	u8 packed_color[4];
+	for(u32 i = 0;i < 4;++i) {
+		packed_color[i] = quantize_unorm8(color[i]);
+	}
+
+	for(u32 i = 0;i < 4;++i) {
+		vertices[i].position[0] = x[i];
+		vertices[i].position[1] = y[i];
+		vertices[i].uvs[0] = quantize_unorm16(u[i]);
+		vertices[i].uvs[1] = quantize_unorm16(v[i]);
+		memcpy(vertices[i].color,packed_color,sizeof(packed_color));
+		vertices[i].texture_layer = (u16)texture_layer;
+		vertices[i].padding = 0;
+	}
 }
+#endif
 
 void render_sprite_sheet_init(Sprite_Sheet *sprite_sheet,const char *path, f32 cell_width, f32 cell_height) {
 	glGenTextures(1,&sprite_sheet->texture_id);
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D,sprite_sheet->texture_id);
+	render_state_bind_texture(0, GL_TEXTURE_2D_ARRAY, sprite_sheet->texture_id);
 
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S,GL_REPEAT);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T,GL_REPEAT);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER,GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S,GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T,GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER,GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER,GL_NEAREST);
 
 	int width,height,channel_count;
-	u8* image_data = stbi_load(path,&width,&height,&channel_count,0);
+	u8* image_data = stbi_load(path,&width,&height,&channel_count,4);
 	if(!image_data) {
 		ERROR_EXIT("Failed to load image: %s\n", path);
 	}
-	glTexImage2D(GL_TEXTURE_2D,0,GL_RGBA8,width,height,0,GL_RGBA,GL_UNSIGNED_BYTE,image_data);
+	// A single layer, so the sheet goes through the same batch shader as the atlases.
+	glTexImage3D(GL_TEXTURE_2D_ARRAY,0,GL_RGBA8,width,height,1,0,GL_RGBA,GL_UNSIGNED_BYTE,image_data);
 	stbi_image_free(image_data);
 
 	sprite_sheet->width = (f32)width;
 	sprite_sheet->height =(f32)height;
 	sprite_sheet->cell_width = cell_width;
 	sprite_sheet->cell_height = cell_height;
+	sprite_sheet->texture_x = 0;
+	sprite_sheet->texture_y = 0;
+	sprite_sheet->texture_width = (f32)width;
+	sprite_sheet->texture_height = (f32)height;
+	sprite_sheet->texture_layer = 0;
 }
 
-static void calculate_sprite_sheet_coords(vec4 result,f32 row, f32 column, f32 texture_width, f32 texture_height, f32 cell_width, f32 cell_height) {
-	f32 w = 1.0/(texture_width/cell_width);
-	f32 h = 1.0/(texture_height/cell_height);
-	f32 x = column * w;
-	f32 y = row * h;
+static void calculate_sprite_sheet_coords(vec4 result,f32 row, f32 column, Sprite_Sheet *sprite_sheet) {
+	f32 w = sprite_sheet->cell_width/sprite_sheet->texture_width;
+	f32 h = sprite_sheet->cell_height/sprite_sheet->texture_height;
+	f32 x = sprite_sheet->texture_x/sprite_sheet->texture_width + column * w;
+	f32 y = sprite_sheet->texture_y/sprite_sheet->texture_height + row * h;
 	result[0] = x;
 	result[1] = y;
 	result[2] = x + w;
 	result[3] = y + h;
 }
 
-void render_sprite_sheet_frame(Sprite_Sheet *sprite_sheet, f32 row, f32 column, vec2 position, bool is_flipped,vec4 color, u32 texture_slots[8]) {
+void render_sprite_sheet_frame(Sprite_Sheet *sprite_sheet, f32 row, f32 column, vec2 position, bool is_flipped,vec4 color) {
 	vec4 uvs;
-	calculate_sprite_sheet_coords(uvs,row,column,sprite_sheet->width,sprite_sheet->height,sprite_sheet->cell_width,sprite_sheet->cell_height);
+	calculate_sprite_sheet_coords(uvs,row,column,sprite_sheet);
+	vec2 size = {sprite_sheet->cell_width,sprite_sheet->cell_height};
+
+	if(stream_count + 1 > batch_quad_capacity ||
+		(batch_texture_id != 0 && batch_texture_id != sprite_sheet->texture_id)) {
+		batch_flush();
+	}
+	batch_texture_id = sprite_sheet->texture_id;
 
+#if RENDER_SPRITE_INSTANCING
+	append_instance(position,size,uvs,color,sprite_sheet->texture_layer,is_flipped);
+#else
 	if(is_flipped) {
 		f32 tmp = uvs[0];
 		uvs[0] = uvs[2];
 		uvs[2] = tmp;
 	}
 
-	vec2 size = {sprite_sheet->cell_width,sprite_sheet->cell_height};
 	vec2 bottom_left = {position[0]-size[0] * 0.5,position[1]-size[1] * 0.5};
-	
-	i32 texture_slot = try_insert_texture(texture_slots, sprite_sheet->texture_id);
-    if (texture_slot == -1) {
-        // TODO: Flush buffer
-    }
-	append_quad(bottom_left,size,uvs, color,(f32)texture_slot);
+	append_quad(bottom_left,size,uvs, color,sprite_sheet->texture_layer);
+#endif
 }
-
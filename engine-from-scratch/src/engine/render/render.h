@@ -6,34 +6,99 @@
 
 #include "../types.h"
 
+// 20 bytes. Positions stay float, sprites are not snapped to whole pixels.
 typedef struct batch_vertex{
     vec2 position;
-    vec2 uvs;
-    vec4 color;
-    f32 texture_slot;
+    // Normalized u16.
+    u16 uvs[2];
+    // Normalized RGBA8.
+    u8 color[4];
+    u16 texture_layer;
+    u16 padding;
 }Batch_Vertex;
 
+// Sprites are drawn as one 32 byte instance each and expanded to a quad from gl_VertexID,
+// instead of 4 Batch_Vertex. Build with RENDER_SPRITE_INSTANCING=0 for the vertex batch.
+#ifndef RENDER_SPRITE_INSTANCING
+#define RENDER_SPRITE_INSTANCING 1
+#endif
+
+#define SPRITE_INSTANCE_FLIPPED 1
+
+typedef struct sprite_instance {
+    vec2 position;
+    vec2 size;
+    // [u0, v0, u1, v1] as normalized u16.
+    u16 uvs[4];
+    // Normalized RGBA8.
+    u8 color[4];
+    u16 texture_layer;
+    u16 flags;
+}Sprite_Instance;
+
 typedef struct sprite_sheet {
     f32 width;
     f32 height;
     f32 cell_width;
     f32 cell_height;
+    // Where the sheet sits in its texture layer, in pixels. A sheet from render_sprite_sheet_init is the whole layer.
+    f32 texture_x;
+    f32 texture_y;
+    f32 texture_width;
+    f32 texture_height;
+    // A GL_TEXTURE_2D_ARRAY, sprites on the same array share a batch whatever their layer.
     u32 texture_id;
+    u32 texture_layer;
 }Sprite_Sheet;
 
-#define MAX_BATCH_QUADS 10000
-#define MAX_BATCH_VERTICES 40000
-#define MAX_BATCH_ELEMENTS 60000
+// Atlases are square powers of two up to this size, sheets that do not fit go to another layer.
+#define ATLAS_MAX_SIZE 4096
+// Empty pixels around every sheet in an atlas.
+#define ATLAS_PADDING 1
 
-SDL_Window* render_init(void);
+#define DEFAULT_BATCH_QUADS 10000
+
+// batch_quad_capacity is how many quads are buffered before the batch is flushed mid-frame,
+// 0 uses DEFAULT_BATCH_QUADS. The GPU buffer holds a few batches so flushes do not wait on each other.
+SDL_Window* render_init(u32 batch_quad_capacity);
 void render_begin(void);
-void render_end(SDL_Window* window, u32 batch_texture_ids[8]);
+void render_end(SDL_Window* window);
 void render_quad(vec2 pos, vec2 size, vec4 color);
-void render_quad_line(vec2 pos, vec2 size, vec4 color);
-void render_line_segment(vec2 start, vec2 end, vec4 color);
-void render_aabb(f32* aabb, vec4 color);
 f32 render_get_scale(void);
+// Batch draw calls issued in the last frame. The batch is flushed early when it is full
+// or when a sprite is on a different texture array than the sprites before it.
+u32 render_get_flush_count(void);
+// Redundant program, vao, buffer, texture and blend binds the state cache skipped in the last frame.
+u32 render_get_state_calls_avoided(void);
+
+// Debug primitives are built from thick-line quads and drawn in one call at render_end, after the sprites.
+// Build with RENDER_DEBUG=0 to strip them, the calls then compile to nothing.
+#ifndef RENDER_DEBUG
+#define RENDER_DEBUG 1
+#endif
+
+// In render units, not window pixels.
+#define RENDER_DEBUG_LINE_WIDTH 1.0f
+#define RENDER_DEBUG_CIRCLE_SEGMENTS 24
+
+#if RENDER_DEBUG
+void render_debug_line(vec2 start, vec2 end, vec4 color);
+void render_debug_rect(vec2 center, vec2 size, vec4 color);
+void render_debug_aabb(f32 *aabb, vec4 color);
+void render_debug_circle(vec2 center, f32 radius, vec4 color);
+#else
+#define render_debug_line(start, end, color) ((void)0)
+#define render_debug_rect(center, size, color) ((void)0)
+#define render_debug_aabb(aabb, color) ((void)0)
+#define render_debug_circle(center, radius, color) ((void)0)
+#endif
 
 //void append_quad(vec2 position, vec2 size, vec4 texture_coordinates, vec4 color);
 void render_sprite_sheet_init(Sprite_Sheet *sprite_sheet,const char *path, f32 cell_width, f32 cell_height);
-void render_sprite_sheet_frame(Sprite_Sheet *sprite_sheet, f32 row, f32 column, vec2 position, bool is_flipped,vec4 color, u32 texture_slots[8]);
\ No newline at end of file
+// Loads the image but leaves the sheet unusable until render_atlas_build packs it. The sheet must stay at the same address.
+void render_sprite_sheet_load(Sprite_Sheet *sprite_sheet,const char *path, f32 cell_width, f32 cell_height);
+// Skyline packs every sheet loaded since the last build into as few same-size atlas pages as possible,
+// uploads the pages as the layers of one texture array and points the sheets at their rects,
+// so all of them draw in one batch. Returns the layer count.
+u32 render_atlas_build(void);
+void render_sprite_sheet_frame(Sprite_Sheet *sprite_sheet, f32 row, f32 column, vec2 position, bool is_flipped,vec4 color);
\ No newline at end of file
@@ -0,0 +1,274 @@
+#include <glad/glad.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stb_image.h>
+
+#include "render.h"
+#include "render_internal.h"
+#include "../util.h"
+#include "../memory/memory.h"
+#include "../array_list/array.h"
+
+#define ATLAS_MIN_SIZE 64
+
+typedef struct atlas_entry {
+	Sprite_Sheet *sprite_sheet;
+	u8 *pixels;
+	u32 width;
+	u32 height;
+	// Top left of the padded rect in its layer.
+	u32 x;
+	u32 y;
+	u32 layer;
+	bool is_placed;
+} Atlas_Entry;
+
+// Top edge of the packed area, sorted by x and covering the whole atlas width.
+typedef struct skyline_node {
+	u32 x;
+	u32 y;
+	u32 width;
+} Skyline_Node;
+
+DEFINE_ARRAY(Atlas_Entry)
+
+static Array_Atlas_Entry pending;
+static bool is_pending_initialized;
+
+void render_sprite_sheet_load(Sprite_Sheet *sprite_sheet, const char *path, f32 cell_width, f32 cell_height) {
+	if (!is_pending_initialized) {
+		array_Atlas_Entry_init(&pending, 0, MEMORY_TAG_RENDER);
+		is_pending_initialized = true;
+	}
+
+	int width, height, channel_count;
+	u8 *pixels = stbi_load(path, &width, &height, &channel_count, 4);
+	if (!pixels) {
+		ERROR_EXIT("Failed to load image: %s\n", path);
+	}
+
+	*sprite_sheet = (Sprite_Sheet){
+		.width = (f32)width,
+		.height = (f32)height,
+		.cell_width = cell_width,
+		.cell_height = cell_height,
+	};
+
+	Atlas_Entry entry = {
+		.sprite_sheet = sprite_sheet,
+		.pixels = pixels,
+		.width = (u32)width,
+		.height = (u32)height,
+	};
+	if (array_Atlas_Entry_push(&pending, entry) == (usize)-1) {
+		ERROR_EXIT("Could not queue image for atlas: %s\n", path);
+	}
+}
+
+// Lowest y where a w x h rect fits with its left edge at nodes[index].x, or -1.
+static i64 skyline_fit(Skyline_Node *nodes, usize node_count, usize index, u32 w, u32 h, u32 size) {
+	if (nodes[index].x + w > size) {
+		return -1;
+	}
+
+	u32 y = 0;
+	u32 width_left = w;
+	for (usize i = index; width_left > 0; ++i) {
+		if (i == node_count) {
+			return -1;
+		}
+		if (nodes[i].y > y) {
+			y = nodes[i].y;
+		}
+		if (y + h > size) {
+			return -1;
+		}
+		width_left -= nodes[i].width < width_left ? nodes[i].width : width_left;
+	}
+
+	return y;
+}
+
+static void skyline_add(Skyline_Node *nodes, usize *node_count, usize index, u32 x, u32 y, u32 w, u32 h) {
+	memmove(&nodes[index + 1], &nodes[index], sizeof(Skyline_Node) * (*node_count - index));
+	nodes[index] = (Skyline_Node){ .x = x, .y = y + h, .width = w };
+	++*node_count;
+
+	// Trim the nodes now covered by the new one.
+	for (usize i = index + 1; i < *node_count;) {
+		u32 right = nodes[index].x + nodes[index].width;
+		if (nodes[i].x >= right) {
+			break;
+		}
+
+		u32 shrink = right - nodes[i].x;
+		if (shrink < nodes[i].width) {
+			nodes[i].x += shrink;
+			nodes[i].width -= shrink;
+			break;
+		}
+
+		memmove(&nodes[i], &nodes[i + 1], sizeof(Skyline_Node) * (*node_count - i - 1));
+		--*node_count;
+	}
+
+	for (usize i = 0; i + 1 < *node_count;) {
+		if (nodes[i].y == nodes[i + 1].y) {
+			nodes[i].width += nodes[i + 1].width;
+			memmove(&nodes[i + 1], &nodes[i + 2], sizeof(Skyline_Node) * (*node_count - i - 2));
+			--*node_count;
+		} else {
+			++i;
+		}
+	}
+}
+
+// Bottom-left skyline packing. Returns true when every entry was placed.
+static bool atlas_pack(Atlas_Entry **entries, usize count, u32 size, Skyline_Node *nodes) {
+	usize node_count = 1;
+	nodes[0] = (Skyline_Node){ .x = 0, .y = 0, .width = size };
+	bool is_all_placed = true;
+
+	for (usize i = 0; i < count; ++i) {
+		Atlas_Entry *entry = entries[i];
+		u32 w = entry->width + ATLAS_PADDING * 2;
+		u32 h = entry->height + ATLAS_PADDING * 2;
+
+		i64 best_y = -1;
+		usize best_index = 0;
+		for (usize j = 0; j < node_count; ++j) {
+			i64 y = skyline_fit(nodes, node_count, j, w, h, size);
+			if (y >= 0 && (best_y < 0 || y < best_y)) {
+				best_y = y;
+				best_index = j;
+			}
+		}
+
+		entry->is_placed = best_y >= 0;
+		if (!entry->is_placed) {
+			is_all_placed = false;
+			continue;
+		}
+
+		entry->x = nodes[best_index].x;
+		entry->y = (u32)best_y;
+		skyline_add(nodes, &node_count, best_index, entry->x, entry->y, w, h);
+	}
+
+	return is_all_placed;
+}
+
+static int compare_entry_height(const void *a, const void *b) {
+	const Atlas_Entry *x = *(Atlas_Entry *const *)a;
+	const Atlas_Entry *y = *(Atlas_Entry *const *)b;
+	return (x->height < y->height) - (x->height > y->height);
+}
+
+static u32 atlas_upload(u32 size, u32 layer_count) {
+	u32 texture_id;
+	glGenTextures(1, &texture_id);
+	render_state_bind_texture(0, GL_TEXTURE_2D_ARRAY, texture_id);
+
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, size, size, layer_count, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+
+	// One page at a time, a full array at ATLAS_MAX_SIZE would be 64MB per layer.
+	usize page_size = (usize)size * size * 4;
+	u8 *pixels = memory_alloc(page_size, MEMORY_TAG_RENDER);
+	if (!pixels) {
+		ERROR_EXIT("Could not allocate memory for a %ux%u atlas\n", size, size);
+	}
+
+	for (u32 layer = 0; layer < layer_count; ++layer) {
+		memset(pixels, 0, page_size);
+
+		for (usize i = 0; i < pending.len; ++i) {
+			Atlas_Entry *entry = &pending.items[i];
+			if (entry->layer != layer) {
+				continue;
+			}
+			for (u32 row = 0; row < entry->height; ++row) {
+				usize dst = (((usize)entry->y + ATLAS_PADDING + row) * size + entry->x + ATLAS_PADDING) * 4;
+				memcpy(pixels + dst, entry->pixels + (usize)row * entry->width * 4, (usize)entry->width * 4);
+			}
+		}
+
+		glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, layer, size, size, 1, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+	}
+
+	memory_free(pixels);
+	return texture_id;
+}
+
+u32 render_atlas_build(void) {
+	usize remaining = pending.len;
+	if (remaining == 0) {
+		return 0;
+	}
+
+	Atlas_Entry **entries = memory_alloc(sizeof(Atlas_Entry *) * remaining, MEMORY_TAG_RENDER);
+	// Every placement adds at most one node.
+	Skyline_Node *nodes = memory_alloc(sizeof(Skyline_Node) * (remaining + 2), MEMORY_TAG_RENDER);
+	if (!entries || !nodes) {
+		ERROR_EXIT("Could not allocate memory for atlas packing\n");
+	}
+	for (usize i = 0; i < remaining; ++i) {
+		entries[i] = &pending.items[i];
+	}
+	// Tallest first keeps the skyline flat.
+	qsort(entries, remaining, sizeof(Atlas_Entry *), compare_entry_height);
+
+	// Layers of an array share a size, so spilling over always packs at ATLAS_MAX_SIZE.
+	u32 size = ATLAS_MIN_SIZE;
+	while (!atlas_pack(entries, remaining, size, nodes) && size < ATLAS_MAX_SIZE) {
+		size *= 2;
+	}
+
+	u32 layer_count = 0;
+	for (;;) {
+		// Keep the unplaced entries for the next layer, in the same order.
+		usize left = 0;
+		for (usize i = 0; i < remaining; ++i) {
+			if (entries[i]->is_placed) {
+				entries[i]->layer = layer_count;
+			} else {
+				entries[left++] = entries[i];
+			}
+		}
+		++layer_count;
+
+		if (left == 0) {
+			break;
+		}
+		if (left == remaining) {
+			ERROR_EXIT("Sprite sheet of %ux%u does not fit in a %d atlas\n", entries[0]->width, entries[0]->height, ATLAS_MAX_SIZE);
+		}
+		remaining = left;
+		atlas_pack(entries, remaining, size, nodes);
+	}
+
+	u32 texture_id = atlas_upload(size, layer_count);
+
+	for (usize i = 0; i < pending.len; ++i) {
+		Atlas_Entry *entry = &pending.items[i];
+		Sprite_Sheet *sprite_sheet = entry->sprite_sheet;
+		sprite_sheet->texture_id = texture_id;
+		sprite_sheet->texture_layer = entry->layer;
+		sprite_sheet->texture_x = (f32)(entry->x + ATLAS_PADDING);
+		sprite_sheet->texture_y = (f32)(entry->y + ATLAS_PADDING);
+		sprite_sheet->texture_width = (f32)size;
+		sprite_sheet->texture_height = (f32)size;
+		stbi_image_free(entry->pixels);
+	}
+
+	printf("Sprite sheets packed: %zu -> %u atlas layers of %u\n", pending.len, layer_count, size);
+
+	memory_free(entries);
+	memory_free(nodes);
+	pending.len = 0;
+
+	return layer_count;
+}
@@ -0,0 +1,141 @@
+#include <glad/glad.h>
+#include <math.h>
+#include <string.h>
+
+#include "render.h"
+#include "render_internal.h"
+#include "../util.h"
+#include "../array_list/array_list.h"
+
+#if RENDER_DEBUG
+
+typedef struct debug_vertex {
+	vec2 position;
+	// Normalized RGBA8.
+	u8 color[4];
+} Debug_Vertex;
+
+static u32 vao_debug;
+static u32 vbo_debug;
+static u32 shader_debug;
+// Triangles for everything drawn this frame, 6 vertices per line.
+static Array_List *list_debug;
+// Bytes the vbo can hold before it has to grow.
+static usize vbo_debug_size;
+
+void render_debug_init(f32 render_width, f32 render_height) {
+	shader_debug = render_shader_create("./shaders/debug.vert", "./shaders/debug.frag");
+
+	mat4x4 projection;
+	mat4x4_ortho(projection, 0, render_width, 0, render_height, -2, 2);
+	render_state_use_program(shader_debug);
+	glUniformMatrix4fv(glGetUniformLocation(shader_debug, "projection"), 1, GL_FALSE, &projection[0][0]);
+
+	glGenVertexArrays(1, &vao_debug);
+	render_state_bind_vertex_array(vao_debug);
+
+	glGenBuffers(1, &vbo_debug);
+	render_state_bind_array_buffer(vbo_debug);
+
+	// [x, y], [r, g, b, a]
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(Debug_Vertex), (void*)offsetof(Debug_Vertex, position));
+	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(Debug_Vertex), (void*)offsetof(Debug_Vertex, color));
+
+	render_state_bind_vertex_array(0);
+	render_state_bind_array_buffer(0);
+
+	list_debug = array_list_create(sizeof(Debug_Vertex), 1024, MEMORY_TAG_RENDER);
+}
+
+void render_debug_flush(void) {
+	if (list_debug->len == 0) {
+		return;
+	}
+
+	usize size = list_debug->len * sizeof(Debug_Vertex);
+	render_state_bind_array_buffer(vbo_debug);
+	if (size > vbo_debug_size) {
+		vbo_debug_size = size * 2;
+	}
+	// Orphan last frame's storage so the upload never waits on the draw that read it.
+	glBufferData(GL_ARRAY_BUFFER, vbo_debug_size, NULL, GL_STREAM_DRAW);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, size, list_debug->items);
+
+	render_state_use_program(shader_debug);
+	render_state_bind_vertex_array(vao_debug);
+	glDrawArrays(GL_TRIANGLES, 0, (GLsizei)list_debug->len);
+
+	list_debug->len = 0;
+}
+
+void render_debug_line(vec2 start, vec2 end, vec4 color) {
+	f32 dx = end[0] - start[0];
+	f32 dy = end[1] - start[1];
+	f32 length = sqrtf(dx * dx + dy * dy);
+	if (length == 0) {
+		return;
+	}
+
+	// Extended by half the width at both ends so the corners of rects close.
+	f32 half = RENDER_DEBUG_LINE_WIDTH * 0.5f;
+	f32 ux = dx / length * half;
+	f32 uy = dy / length * half;
+	vec2 corners[4] = {
+		{ start[0] - ux - uy, start[1] - uy + ux },
+		{ start[0] - ux + uy, start[1] - uy - ux },
+		{ end[0] + ux + uy, end[1] + uy - ux },
+		{ end[0] + ux - uy, end[1] + uy + ux },
+	};
+
+	u8 packed_color[4];
+	for (u32 i = 0; i < 4; ++i) {
+		f32 value = color[i] < 0 ? 0 : color[i] > 1 ? 1 : color[i];
+		packed_color[i] = (u8)(value * 255.0f + 0.5f);
+	}
+
+	Debug_Vertex *vertices = array_list_extend_uninit(list_debug, 6);
+	if (!vertices) {
+		return;
+	}
+	u8 quad[6] = { 0, 1, 2, 2, 3, 0 };
+	for (u32 i = 0; i < 6; ++i) {
+		vertices[i].position[0] = corners[quad[i]][0];
+		vertices[i].position[1] = corners[quad[i]][1];
+		memcpy(vertices[i].color, packed_color, sizeof(packed_color));
+	}
+}
+
+void render_debug_rect(vec2 center, vec2 size, vec4 color) {
+	vec2 points[4] = {
+		{ center[0] - size[0] * 0.5f, center[1] - size[1] * 0.5f },
+		{ center[0] + size[0] * 0.5f, center[1] - size[1] * 0.5f },
+		{ center[0] + size[0] * 0.5f, center[1] + size[1] * 0.5f },
+		{ center[0] - size[0] * 0.5f, center[1] + size[1] * 0.5f },
+	};
+
+	render_debug_line(points[0], points[1], color);
+	render_debug_line(points[1], points[2], color);
+	render_debug_line(points[2], points[3], color);
+	render_debug_line(points[3], points[0], color);
+}
+
+void render_debug_aabb(f32 *aabb, vec4 color) {
+	vec2 size;
+	vec2_scale(size, &aabb[2], 2);
+	render_debug_rect(&aabb[0], size, color);
+}
+
+void render_debug_circle(vec2 center, f32 radius, vec4 color) {
+	f32 step = 2.0f * 3.14159265f / RENDER_DEBUG_CIRCLE_SEGMENTS;
+	vec2 previous = { center[0] + radius, center[1] };
+	for (u32 i = 1; i <= RENDER_DEBUG_CIRCLE_SEGMENTS; ++i) {
+		vec2 point = { center[0] + cosf(step * i) * radius, center[1] + sinf(step * i) * radius };
+		render_debug_line(previous, point, color);
+		previous[0] = point[0];
+		previous[1] = point[1];
+	}
+}
+
+#endif // RENDER_DEBUG
@@ -3,12 +3,22 @@
 
 #include "../global.h"
 #include "../util.h"
+#include "../memory/memory.h"
 
 #include "render.h"
 #include "render_internal.h"
 
 static mat4x4 projection;
 
+// GL 4.4 / GL_ARB_buffer_storage, not part of the 3.3 core loader.
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#endif
+#ifndef GL_MAP_COHERENT_BIT
+#define GL_MAP_COHERENT_BIT 0x0080
+#endif
+typedef void (APIENTRYP PFN_BUFFER_STORAGE)(GLenum target, GLsizeiptr size, const void *data, GLbitfield flags);
+
 SDL_Window* render_init_window(u32 width, u32 height) {
 	SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE);
 	SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 3);
@@ -46,41 +56,108 @@ SDL_Window* render_init_window(u32 width, u32 height) {
 
 	return window;
 }
-void render_init_batch_quads(u32* vao, u32* vbo, u32* ebo) {
+// Allocates the bound GL_ARRAY_BUFFER and maps it for good when persistent mapping is available.
+static void* render_init_stream_buffer(usize buffer_size) {
+	void *mapped = NULL;
+	PFN_BUFFER_STORAGE buffer_storage = NULL;
+	if (SDL_GL_ExtensionSupported("GL_ARB_buffer_storage")) {
+		buffer_storage = (PFN_BUFFER_STORAGE)SDL_GL_GetProcAddress("glBufferStorage");
+	}
+	if (buffer_storage) {
+		GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		buffer_storage(GL_ARRAY_BUFFER, buffer_size, NULL, flags);
+		mapped = glMapBufferRange(GL_ARRAY_BUFFER, 0, buffer_size, flags);
+	} else {
+		glBufferData(GL_ARRAY_BUFFER, buffer_size, NULL, GL_STREAM_DRAW);
+	}
+	printf("Batch stream: %u x %zu bytes, %s\n", RENDER_STREAM_SEGMENTS, buffer_size / RENDER_STREAM_SEGMENTS, mapped ? "persistent" : "mapped per segment");
+
+	return mapped;
+}
+
+void* render_init_batch_quads(u32* vao, u32* vbo, u32* ebo, u32* index_type, u32 quad_capacity) {
 	glGenVertexArrays(1, vao);
-	glBindVertexArray(*vao);
-
-	u32 indices[MAX_BATCH_ELEMENTS];
-	for (u32 i = 0, offset = 0; i < MAX_BATCH_ELEMENTS; i += 6, offset += 4) {
-		indices[i + 0] = offset + 0;
-		indices[i + 1] = offset + 1;
-		indices[i + 2] = offset + 2;
-		indices[i + 3] = offset + 2;
-		indices[i + 4] = offset + 3;
-		indices[i + 5] = offset + 0;
+	render_state_bind_vertex_array(*vao);
+
+	// Draws use a base vertex per segment, so indices only have to address one segment.
+	bool is_short = (usize)quad_capacity * 4 <= 65536;
+	usize index_size = is_short ? sizeof(u16) : sizeof(u32);
+	*index_type = is_short ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+
+	usize element_count = (usize)quad_capacity * 6;
+	void *indices = memory_alloc(element_count * index_size, MEMORY_TAG_RENDER);
+	if (!indices) {
+		ERROR_EXIT("Could not allocate batch indices\n");
+	}
+	u8 quad[6] = { 0, 1, 2, 2, 3, 0 };
+	for (usize i = 0; i < element_count; ++i) {
+		u32 index = (u32)(i / 6) * 4 + quad[i % 6];
+		if (is_short) {
+			((u16*)indices)[i] = (u16)index;
+		} else {
+			((u32*)indices)[i] = index;
+		}
 	}
 
 	glGenBuffers(1, vbo);
-	glBindBuffer(GL_ARRAY_BUFFER, *vbo);
-	glBufferData(GL_ARRAY_BUFFER, MAX_BATCH_VERTICES * sizeof(Batch_Vertex), NULL, GL_DYNAMIC_DRAW);
+	render_state_bind_array_buffer(*vbo);
+
+	void *mapped = render_init_stream_buffer((usize)quad_capacity * 4 * sizeof(Batch_Vertex) * RENDER_STREAM_SEGMENTS);
 
-	// [x, y], [u, v], [r, g, b, a], [texture_slot]
+	// [x, y], [u, v], [r, g, b, a], [texture_layer]
 	glEnableVertexAttribArray(0);
 	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(Batch_Vertex), (void*)offsetof(Batch_Vertex, position));
 	glEnableVertexAttribArray(1);
-	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(Batch_Vertex), (void*)offsetof(Batch_Vertex, uvs));
+	glVertexAttribPointer(1, 2, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(Batch_Vertex), (void*)offsetof(Batch_Vertex, uvs));
 	glEnableVertexAttribArray(2);
-	glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, sizeof(Batch_Vertex), (void*)offsetof(Batch_Vertex, color));
+	glVertexAttribPointer(2, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(Batch_Vertex), (void*)offsetof(Batch_Vertex, color));
 	glEnableVertexAttribArray(3);
-	glVertexAttribPointer(3, 1, GL_FLOAT, GL_FALSE, sizeof(Batch_Vertex), (void*)offsetof(Batch_Vertex, texture_slot));
+	glVertexAttribIPointer(3, 1, GL_UNSIGNED_SHORT, sizeof(Batch_Vertex), (void*)offsetof(Batch_Vertex, texture_layer));
 
 	glGenBuffers(1, ebo);
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, *ebo);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, MAX_BATCH_ELEMENTS * sizeof(u32), indices, GL_STATIC_DRAW);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, element_count * index_size, indices, GL_STATIC_DRAW);
+	memory_free(indices);
 
-	glBindVertexArray(0);
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	render_state_bind_vertex_array(0);
+	render_state_bind_array_buffer(0);
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+	return mapped;
+}
+
+void* render_init_batch_instances(u32 vaos[RENDER_STREAM_SEGMENTS], u32* vbo, u32 quad_capacity) {
+	glGenBuffers(1, vbo);
+	render_state_bind_array_buffer(*vbo);
+	usize segment_size = (usize)quad_capacity * sizeof(Sprite_Instance);
+	void *mapped = render_init_stream_buffer(segment_size * RENDER_STREAM_SEGMENTS);
+
+	glGenVertexArrays(RENDER_STREAM_SEGMENTS, vaos);
+	for (u32 i = 0; i < RENDER_STREAM_SEGMENTS; ++i) {
+		render_state_bind_vertex_array(vaos[i]);
+		u8 *base = (u8*)(segment_size * i);
+
+		// [x, y], [w, h], [u0, v0, u1, v1], [r, g, b, a], [texture_layer, flags], all per instance
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(Sprite_Instance), base + offsetof(Sprite_Instance, position));
+		glEnableVertexAttribArray(1);
+		glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(Sprite_Instance), base + offsetof(Sprite_Instance, size));
+		glEnableVertexAttribArray(2);
+		glVertexAttribPointer(2, 4, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(Sprite_Instance), base + offsetof(Sprite_Instance, uvs));
+		glEnableVertexAttribArray(3);
+		glVertexAttribPointer(3, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(Sprite_Instance), base + offsetof(Sprite_Instance, color));
+		glEnableVertexAttribArray(4);
+		glVertexAttribIPointer(4, 2, GL_UNSIGNED_SHORT, sizeof(Sprite_Instance), base + offsetof(Sprite_Instance, texture_layer));
+
+		for (u32 attribute = 0; attribute < 5; ++attribute) {
+			glVertexAttribDivisor(attribute, 1);
+		}
+	}
+
+	render_state_bind_vertex_array(0);
+	render_state_bind_array_buffer(0);
+
+	return mapped;
 }
 
 void render_init_quad(u32* vao, u32* vbo, u32* ebo) {
@@ -101,9 +178,9 @@ void render_init_quad(u32* vao, u32* vbo, u32* ebo) {
 	glGenBuffers(1, vbo);
 	glGenBuffers(1, ebo);
 
-	glBindVertexArray(*vao);
+	render_state_bind_vertex_array(*vao);
 
-	glBindBuffer(GL_ARRAY_BUFFER, *vbo);
+	render_state_bind_array_buffer(*vbo);
 	glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
 
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, *ebo);
@@ -118,15 +195,19 @@ void render_init_quad(u32* vao, u32* vbo, u32* ebo) {
 	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(f32), (void*)(3 * sizeof(f32)));
 	glEnableVertexAttribArray(1);
 
-	glBindVertexArray(0);
+	render_state_bind_vertex_array(0);
 }
 
 void render_init_shaders(u32* default_shader, u32* shader_batch, f32 render_width, f32 render_height) {
 	*default_shader = render_shader_create("./shaders/default.vert", "./shaders/default.frag");
+#if RENDER_SPRITE_INSTANCING
+	*shader_batch = render_shader_create("./shaders/sprite_instance.vert", "./shaders/batch_quad.frag");
+#else
 	*shader_batch = render_shader_create("./shaders/batch_quad.vert", "./shaders/batch_quad.frag");
+#endif
 
 	mat4x4_ortho(projection, 0, render_width, 0, render_height, -2, 2);
-	glUseProgram(*default_shader);
+	render_state_use_program(*default_shader);
 	glUniformMatrix4fv(
 		glGetUniformLocation(*default_shader, "projection"),
 		1,
@@ -135,7 +216,7 @@ void render_init_shaders(u32* default_shader, u32* shader_batch, f32 render_widt
 	);
 
 	
-	glUseProgram(*shader_batch);
+	render_state_use_program(*shader_batch);
 	glUniformMatrix4fv(
 		glGetUniformLocation(*shader_batch, "projection"),
 		1,
@@ -143,36 +224,16 @@ void render_init_shaders(u32* default_shader, u32* shader_batch, f32 render_widt
 		&projection[0][0]
 	);
 
-	for (u32 i = 0; i < 8; ++i) {
-        char name[] = "texture_slot_N";
-        sprintf(name, "texture_slot_%u", i);
-        glUniform1i(glGetUniformLocation(*shader_batch, name), i);
-    }
+	glUniform1i(glGetUniformLocation(*shader_batch, "texture_array"), 0);
 }
 
 void render_init_color_texture(u32* texture) {
 	glGenTextures(1, texture);
-	glBindTexture(GL_TEXTURE_2D, *texture);
+	render_state_bind_texture(0, GL_TEXTURE_2D, *texture);
 
 	u8 solid_white[4] = { 255,255,255,255 };
 
 	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA,1,1,0, GL_RGBA, GL_UNSIGNED_BYTE, solid_white);
 
-	glBindTexture(GL_TEXTURE_2D,0);
+	render_state_bind_texture(0, GL_TEXTURE_2D, 0);
 }
-
-void render_init_line(u32* vao, u32* vbo) {
-	glGenVertexArrays(1, vao);
-	glBindVertexArray(*vao);
-
-	glGenBuffers(1, vbo);
-	glBindBuffer(GL_ARRAY_BUFFER,*vbo);
-	glBufferData(GL_ARRAY_BUFFER,6 * sizeof(f32), NULL, GL_DYNAMIC_DRAW);
-
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(f32), NULL);
-	glEnableVertexAttribArray(0);
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
-
-	glBindVertexArray(0);
-
-}
\ No newline at end of file
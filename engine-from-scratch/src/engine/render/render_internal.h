@@ -12,9 +12,40 @@ SDL_Window* render_init_window(u32 width, u32 height);
 void render_init_quad(u32* vao, u32* vbo, u32* ebo);
 void render_init_color_texture(u32* texture);
 void render_init_shaders(u32* default_shader, u32* shader_batch, f32 render_width, f32 render_height);
-void render_init_batch_quads(u32* vao, u32* vbo, u32* ebo);
-void render_init_line(u32* vao, u32* vbo);
+// Batch vertices stream through a ring of segments, each quad_capacity quads long, so the CPU
+// fills one while the GPU may still be reading the others.
+#define RENDER_STREAM_SEGMENTS 3
+
+// The vbo holds RENDER_STREAM_SEGMENTS * quad_capacity quads. Returns the whole buffer mapped for
+// good when GL_ARB_buffer_storage is available, otherwise NULL and segments are mapped one at a time.
+// index_type is set to GL_UNSIGNED_SHORT when quad_capacity * 4 vertices fit in u16.
+void* render_init_batch_quads(u32* vao, u32* vbo, u32* ebo, u32* index_type, u32 quad_capacity);
+// Same as render_init_batch_quads for Sprite_Instance, with a vao per segment.
+void* render_init_batch_instances(u32 vaos[RENDER_STREAM_SEGMENTS], u32* vbo, u32 quad_capacity);
+
+#if RENDER_DEBUG
+void render_debug_init(f32 render_width, f32 render_height);
+// Draws and clears every debug primitive added since the last flush.
+void render_debug_flush(void);
+#else
+#define render_debug_init(render_width, render_height) ((void)0)
+#define render_debug_flush() ((void)0)
+#endif
 
 u32 render_shader_create(const char* path_vert, const char* path_frag);
 
+#define RENDER_STATE_TEXTURE_UNITS 8
+
+// Skip the gl call when the value is already bound. Use these instead of glUseProgram, glBindVertexArray,
+// glBindBuffer(GL_ARRAY_BUFFER), glActiveTexture/glBindTexture and glEnable/glBlendFunc(GL_BLEND)
+// anywhere in the render module. Element buffers are vao state and are bound directly.
+void render_state_use_program(u32 program);
+void render_state_bind_vertex_array(u32 vao);
+void render_state_bind_array_buffer(u32 buffer);
+// target is GL_TEXTURE_2D or GL_TEXTURE_2D_ARRAY.
+void render_state_bind_texture(u32 unit, u32 target, u32 texture);
+void render_state_set_blend(bool is_enabled, u32 src, u32 dst);
+// Calls skipped since the last take.
+u32 render_state_take_calls_avoided(void);
+
 #endif // !RENDER_INTERNAL_H
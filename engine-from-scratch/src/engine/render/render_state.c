@@ -0,0 +1,94 @@
+#include <glad/glad.h>
+
+#include "render_internal.h"
+
+// Mirrors the GL state the renderer binds, starting from the defaults of a fresh context.
+// Every bind in the render module goes through here, a direct gl call would leave it stale.
+typedef struct render_state {
+	u32 program;
+	u32 vertex_array;
+	u32 array_buffer;
+	u32 active_unit;
+	// [unit][0] is GL_TEXTURE_2D, [unit][1] is GL_TEXTURE_2D_ARRAY.
+	u32 textures[RENDER_STATE_TEXTURE_UNITS][2];
+	bool is_blend_enabled;
+	u32 blend_src;
+	u32 blend_dst;
+	u32 calls_avoided;
+} Render_State;
+
+static Render_State state = {
+	.blend_src = GL_ONE,
+	.blend_dst = GL_ZERO,
+};
+
+void render_state_use_program(u32 program) {
+	if (state.program == program) {
+		++state.calls_avoided;
+		return;
+	}
+	glUseProgram(program);
+	state.program = program;
+}
+
+void render_state_bind_vertex_array(u32 vao) {
+	if (state.vertex_array == vao) {
+		++state.calls_avoided;
+		return;
+	}
+	glBindVertexArray(vao);
+	state.vertex_array = vao;
+}
+
+void render_state_bind_array_buffer(u32 buffer) {
+	if (state.array_buffer == buffer) {
+		++state.calls_avoided;
+		return;
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, buffer);
+	state.array_buffer = buffer;
+}
+
+void render_state_bind_texture(u32 unit, u32 target, u32 texture) {
+	u32 *bound = &state.textures[unit][target == GL_TEXTURE_2D_ARRAY];
+	if (*bound == texture) {
+		++state.calls_avoided;
+		return;
+	}
+
+	if (state.active_unit != unit) {
+		glActiveTexture(GL_TEXTURE0 + unit);
+		state.active_unit = unit;
+	} else {
+		++state.calls_avoided;
+	}
+	glBindTexture(target, texture);
+	*bound = texture;
+}
+
+void render_state_set_blend(bool is_enabled, u32 src, u32 dst) {
+	if (state.is_blend_enabled != is_enabled) {
+		if (is_enabled) {
+			glEnable(GL_BLEND);
+		} else {
+			glDisable(GL_BLEND);
+		}
+		state.is_blend_enabled = is_enabled;
+	} else {
+		++state.calls_avoided;
+	}
+
+	if (state.blend_src != src || state.blend_dst != dst) {
+		glBlendFunc(src, dst);
+		state.blend_src = src;
+		state.blend_dst = dst;
+	} else {
+		++state.calls_avoided;
+	}
+}
+
+u32 render_state_take_calls_avoided(void) {
+	u32 count = state.calls_avoided;
+	state.calls_avoided = 0;
+	return count;
+}
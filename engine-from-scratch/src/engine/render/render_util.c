@@ -3,6 +3,7 @@
 
 #include "..\util.h"
 #include "..\io\io.h"
+#include "..\memory\memory.h"
 #include "render_internal.h"
 
 
@@ -48,8 +49,8 @@ u32 render_shader_create(const char* path_vert, const char* path_frag) {
 		ERROR_EXIT("Error linking shader: %s\n", log);
 	}
 
-	free(file_vertex.data);
-	free(file_fragment.data);
+	memory_free(file_vertex.data);
+	memory_free(file_fragment.data);
 
 	return shader;
 }
\ No newline at end of file
@@ -0,0 +1,133 @@
+#include <string.h>
+
+#include "world.h"
+#include "../util.h"
+#include "../io/io.h"
+#include "../io/blob.h"
+#include "../memory/memory.h"
+#include "../ecs/ecs.h"
+#include "../physics/physics.h"
+#include "../entity/entity.h"
+#include "../animation/animation.h"
+
+typedef struct world_snapshot_header {
+	u32 magic;
+	u32 version;
+	// Layout checks, the sections store these structs as-is.
+	u32 usize_size;
+	u32 body_size;
+	u32 entity_size;
+	u32 animation_size;
+	u64 size;
+	u64 ecs;
+	u64 physics;
+	u64 entities;
+} World_Snapshot_Header;
+
+static World_Snapshot_Header header_create(void) {
+	return (World_Snapshot_Header){
+		.magic = WORLD_SNAPSHOT_MAGIC,
+		.version = WORLD_SNAPSHOT_VERSION,
+		.usize_size = sizeof(usize),
+		.body_size = sizeof(Body),
+		.entity_size = sizeof(Entity),
+		.animation_size = sizeof(Animation),
+	};
+}
+
+static void world_write(Blob_Writer *writer) {
+	u64 offset = blob_reserve(writer, sizeof(World_Snapshot_Header));
+	World_Snapshot_Header header = header_create();
+	header.ecs = ecs_snapshot_write(writer);
+	header.physics = physics_snapshot_write(writer);
+	header.entities = entity_snapshot_write(writer);
+	header.size = writer->len;
+
+	if (writer->data) {
+		memcpy(blob_ptr(writer, offset), &header, sizeof(World_Snapshot_Header));
+	}
+}
+
+World_Snapshot world_snapshot_save(void) {
+	// First pass only measures, second pass writes.
+	Blob_Writer writer = {0};
+	world_write(&writer);
+
+	World_Snapshot snapshot = { .len = writer.len };
+	snapshot.data = memory_alloc(snapshot.len, MEMORY_TAG_ASSET);
+	if (!snapshot.data) {
+		ERROR_EXIT("Could not allocate memory for world snapshot\n");
+	}
+	// Padding between sections is not written otherwise.
+	memset(snapshot.data, 0, snapshot.len);
+
+	writer = (Blob_Writer){ .data = snapshot.data };
+	world_write(&writer);
+
+	return snapshot;
+}
+
+void world_snapshot_free(World_Snapshot *snapshot) {
+	memory_free(snapshot->data);
+	*snapshot = (World_Snapshot){0};
+}
+
+typedef struct world_snapshot_context {
+	const u8 *data;
+	usize len;
+	u64 entities;
+} World_Snapshot_Context;
+
+// Entities, bodies and animations share ECS rows, each module checks its own columns.
+static bool world_snapshot_check_chunk(Ecs_Mask mask, Ecs_View *view, void *context) {
+	World_Snapshot_Context *sections = context;
+	return physics_snapshot_check_chunk(mask, view) && animation_snapshot_check_chunk(mask, view)
+		&& entity_snapshot_check_chunk(sections->data, sections->len, sections->entities, mask, view);
+}
+
+bool world_snapshot_load(const void *data, usize len) {
+	const World_Snapshot_Header *header = blob_at(data, len, 0, sizeof(World_Snapshot_Header));
+	if (!header || header->magic != WORLD_SNAPSHOT_MAGIC) {
+		ERROR_RETURN(false, "Not a world snapshot\n");
+	}
+
+	World_Snapshot_Header expected = header_create();
+	if (header->version != expected.version) {
+		ERROR_RETURN(false, "World snapshot version %u is not supported, expected %u\n", header->version, expected.version);
+	}
+	if (header->usize_size != expected.usize_size || header->body_size != expected.body_size || header->entity_size != expected.entity_size || header->animation_size != expected.animation_size) {
+		ERROR_RETURN(false, "World snapshot was saved by an incompatible build\n");
+	}
+	if (header->size != len) {
+		ERROR_RETURN(false, "World snapshot is truncated\n");
+	}
+
+	// Everything is checked before anything is replaced, so a bad file leaves the world as it was.
+	// Entity tags are checked last, they refer to ECS rows.
+	World_Snapshot_Context context = { .data = data, .len = len, .entities = header->entities };
+	if (!physics_snapshot_validate(data, len, header->physics) || !ecs_snapshot_validate(data, len, header->ecs, world_snapshot_check_chunk, &context)
+		|| !entity_snapshot_validate(data, len, header->entities, header->ecs)) {
+		return false;
+	}
+
+	ecs_snapshot_read(data, len, header->ecs);
+	physics_snapshot_read(data, len, header->physics);
+	entity_snapshot_read(data, len, header->entities);
+
+	return true;
+}
+
+int world_snapshot_write_file(World_Snapshot *snapshot, const char *path) {
+	return io_file_write(snapshot->data, snapshot->len, path);
+}
+
+bool world_snapshot_read_file(const char *path) {
+	File file = io_file_read(path);
+	if (!file.is_valid) {
+		return false;
+	}
+
+	bool is_loaded = world_snapshot_load(file.data, file.len);
+	memory_free(file.data);
+	return is_loaded;
+}
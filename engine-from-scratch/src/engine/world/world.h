@@ -0,0 +1,27 @@
+#pragma once
+
+#include <stdbool.h>
+
+#include "../types.h"
+
+#define WORLD_SNAPSHOT_MAGIC 0x444C5257 // "WRLD"
+#define WORLD_SNAPSHOT_VERSION 4
+
+// Versioned binary snapshot of the ECS rows (entities, bodies, animations), statics and entity
+// tags. The blob is flat and
+// pointer-free: every array is found by its offset from the start and callbacks are stored
+// as ids registered with physics_on_hit_register / physics_on_hit_static_register. It can be
+// written to disk as-is and loaded from a read-only mapping of the file.
+typedef struct world_snapshot {
+	u8 *data;
+	usize len;
+} World_Snapshot;
+
+// Call at the frame's sync point, after entity_commands_flush. data is allocated with memory_alloc (MEMORY_TAG_ASSET).
+World_Snapshot world_snapshot_save(void);
+void world_snapshot_free(World_Snapshot *snapshot);
+// Replaces the whole world with the snapshot. On failure the world is left untouched.
+bool world_snapshot_load(const void *data, usize len);
+
+int world_snapshot_write_file(World_Snapshot *snapshot, const char *path);
+bool world_snapshot_read_file(const char *path);
@@ -10,14 +10,17 @@
 #include "engine/config/config.h"
 #include "engine/input/input.h"
 #include "engine/physics/physics.h"
+#include "engine/ecs/ecs.h"
 #include "engine/entity/entity.h"
+#include "engine/world/world.h"
 #include "engine/render/render.h"
 #include "engine/animation/animation.h"
 #include "engine/audio/audio.h"
+#include "engine/arena/arena.h"
+#include "engine/memory/memory.h"
 
 void reset(void);
 
-static u32 texture_slots[8] = {0};
 static f32 width;
 static f32 height;
 
@@ -36,8 +39,21 @@ static const f32 SPEED_ENEMY_LARGE = 80;
 static const f32 SPEED_ENEMY_SMALL = 100;
 static const f32 HEALTH_ENEMY_LARGE = 7;
 static const f32 HEALTH_ENEMY_SMALL = 3;
+static const f32 PROJECTILE_LIFETIME = 3;
+// Entities further than this outside the screen are culled.
+static const f32 CULL_MARGIN = 64;
 
 
+typedef enum game_tag {
+	GAME_TAG_ENEMY = 1,
+	GAME_TAG_SMALL = 1 << 1,
+	GAME_TAG_ENRAGED = 1 << 2,
+	GAME_TAG_PROJECTILE = 1 << 3,
+	GAME_TAG_PROJECTILE_SMALL = 1 << 4,
+	// Enemy walks left.
+	GAME_TAG_FLIPPED = 1 << 5,
+} Game_Tag;
+
 typedef enum collision_layer{
 	COLLISION_LAYER_PLAYER = 1,
 	COLLISION_LAYER_ENEMY = 1 << 1,
@@ -69,6 +85,8 @@ typedef struct weapon {
     vec2 sprite_size;
     vec2 sprite_offset;
     usize projectile_animation_id;
+    // Indexed by is_flipped.
+    usize projectile_prefab_ids[2];
     Mix_Chunk *sfx;
 } Weapon;
 
@@ -85,9 +103,13 @@ static f32 spawn_timer = 0;
 
 static Weapon_Type weapon_type = WEAPON_TYPE_PISTOL;
 static bool shouldQuit = false;
+// Set by physics callbacks, the level is reset once physics_update is done with its rows.
+static bool should_reset = false;
 static vec2 pos;
 static bool player_is_grounded = false;
 static usize player_id;
+// Taken right after the level is first built, restarting loads it instead of rebuilding.
+static World_Snapshot level_snapshot;
 static usize anim_player_walk_id;
 static usize anim_player_idle_id;
 static usize anim_enemy_small_id;
@@ -99,10 +121,8 @@ static usize anim_projectile_small_id;
 
 void projectile_on_hit(Body *self, Body *other, Hit hit) {
 	if (other->collision_layer == COLLISION_LAYER_ENEMY) {
-        Entity *projectile = entity_get(self->entity_id);
-        Entity *enemy = entity_get(other->entity_id);
-        if (projectile->animation_id == anim_projectile_small_id) {
-            if (entity_damage(other->entity_id, 1)) {
+        if (entity_has_tags(self->id, GAME_TAG_PROJECTILE_SMALL)) {
+            if (entity_damage(other->id, 1)) {
                 audio_sound_play(SOUND_ENEMY_DEATH);
             }
         }
@@ -111,22 +131,19 @@ void projectile_on_hit(Body *self, Body *other, Hit hit) {
 }
 
 void projectile_on_hit_static(Body *self, Static_Body *other, Hit hit) {
-        Entity *projectile = entity_get(self->entity_id);
-        if (projectile->animation_id == anim_projectile_small_id) {
+        if (entity_has_tags(self->id, GAME_TAG_PROJECTILE_SMALL)) {
             audio_sound_play(SOUND_SHOOT);
         }
-        entity_destroy(self->entity_id);
+        entity_command_destroy(self->id);
 }
 
 static void spawn_projectile(Projectile_Type projectile_type) {
     Weapon weapon = weapons[weapon_type];
-    Entity *player = entity_get(player_id);
-    Body *body = physics_body_get(player->body_id);
-    Animation *animation = animation_get(player->animation_id);
+    Body *body = physics_body_get(player_id);
+    Animation *animation = ecs_get(player_id, animation_components.animation);
     bool is_flipped = animation->is_flipped;
-    vec2 velocity = {is_flipped ? -weapon.projectile_speed : weapon.projectile_speed, 0};
 
-    entity_create(body->aabb.position, weapon.sprite_size, weapon.sprite_offset, velocity, COLLISION_LAYER_PROJECTILE, projectile_mask, true, weapon.projectile_animation_id, projectile_on_hit, projectile_on_hit_static);
+    entity_spawn_batch(weapon.projectile_prefab_ids[is_flipped], 1, &body->aabb.position, NULL);
     audio_sound_play(weapon.sfx);
 }
 
@@ -137,22 +154,15 @@ static void input_handle(Body* body_player) {
 		shouldQuit = true;
 	}
 
-    Animation *walk_anim = animation_get(anim_player_walk_id);
-    Animation *idle_anim = animation_get(anim_player_idle_id);
-
 	f32 velx = 0;
 	f32 vely = body_player->velocity[1];
 
 	if (global.input.right) {
 		velx += SPEED_PLAYER;
-        walk_anim->is_flipped = false;
-        idle_anim->is_flipped = false;
 	}
 
 	if (global.input.left) {
 		velx -= SPEED_PLAYER;
-        walk_anim->is_flipped = true;
-        idle_anim->is_flipped = true;
 	}
 
 	if (global.input.up && player_is_grounded) {
@@ -183,57 +193,48 @@ void player_on_hit_static(Body *self, Static_Body *other, Hit hit) {
 	}
 }
 
-void enemy_small_on_hit_static(Body *self, Static_Body *other, Hit hit) {
-	Entity *entity = entity_get(self->entity_id);
-
+// Only turns the enemy around, enemy_speed_system sets the speed for its tags every frame.
+void enemy_on_hit_static(Body *self, Static_Body *other, Hit hit) {
 	if (hit.normal[0] > 0) {
-        if (entity->is_enraged) {
-            self->velocity[0] = SPEED_ENEMY_SMALL * 1.5f;
-        } else {
-            self->velocity[0] = SPEED_ENEMY_SMALL;
-        }
+        entity_tag_remove(self->id, GAME_TAG_FLIPPED);
 	}
 
 	if (hit.normal[0] < 0) {
-        if (entity->is_enraged) {
-            self->velocity[0] = -SPEED_ENEMY_SMALL * 1.5f;
-        } else {
-            self->velocity[0] = -SPEED_ENEMY_SMALL;
-        }
+        entity_tag_add(self->id, GAME_TAG_FLIPPED);
 	}
 }
 
-void enemy_large_on_hit_static(Body *self, Static_Body *other, Hit hit) {
-	 Entity *entity = entity_get(self->entity_id);
-
-	if (hit.normal[0] > 0) {
-        if (entity->is_enraged) {
-            self->velocity[0] = SPEED_ENEMY_LARGE * 1.5f;
-        } else {
-            self->velocity[0] = SPEED_ENEMY_LARGE;
+// Each enemy class is one tag query, so the loop only visits the matching ids instead of testing
+// every entity's tags.
+static void enemy_speed_system(void) {
+    for (usize i = 0; i < 4; ++i) {
+        bool is_small = i & 1;
+        bool is_enraged = (i >> 1) & 1;
+        f32 speed = is_small ? SPEED_ENEMY_SMALL : SPEED_ENEMY_LARGE;
+        if (is_enraged) {
+            speed *= 1.5f;
         }
-	}
 
-	if (hit.normal[0] < 0) {
-        if (entity->is_enraged) {
-            self->velocity[0] = -SPEED_ENEMY_LARGE * 1.5f;
-        } else {
-            self->velocity[0] = -SPEED_ENEMY_LARGE;
+        u64 all = GAME_TAG_ENEMY | (is_small ? GAME_TAG_SMALL : 0) | (is_enraged ? GAME_TAG_ENRAGED : 0);
+        u64 none = (is_small ? 0 : GAME_TAG_SMALL) | (is_enraged ? 0 : GAME_TAG_ENRAGED);
+        usize *ids;
+        usize count = entity_tag_query(all, none, &ids);
+
+        for (usize j = 0; j < count; ++j) {
+            Body *body = physics_body_get(ids[j]);
+            body->velocity[0] = entity_has_tags(ids[j], GAME_TAG_FLIPPED) ? -speed : speed;
         }
-	}
-	
+    }
 }
 
+// Indexed by [is_small][is_enraged][is_flipped].
+static usize enemy_prefab_ids[2][2][2];
 
-
-void spawn_enemy(bool is_small, bool is_enraged, bool is_flipped) {
-	f32 spawn_x = is_flipped ? width : 0;
-    vec2 position = {spawn_x, (height - 64)};
+static void enemy_prefab_create(bool is_small, bool is_enraged, bool is_flipped) {
     f32 speed = SPEED_ENEMY_LARGE;
     vec2 size = {20, 20};
     vec2 sprite_offset = {0, 10};
     usize animation_id = anim_enemy_large_id;
-    On_Hit_Static on_hit_static = enemy_large_on_hit_static;
 
     if (is_small) {
         size[0] = 12;
@@ -241,7 +242,6 @@ void spawn_enemy(bool is_small, bool is_enraged, bool is_flipped) {
         sprite_offset[0] = 0;
         sprite_offset[1] = 6;
         animation_id = anim_enemy_small_id;
-        on_hit_static = enemy_small_on_hit_static;
         speed = SPEED_ENEMY_SMALL;	
     } 
 
@@ -250,36 +250,80 @@ void spawn_enemy(bool is_small, bool is_enraged, bool is_flipped) {
         animation_id = is_small ? anim_enemy_small_enraged_id : anim_enemy_large_enraged_id;
     }
 
-    vec2 velocity = {is_flipped ? -speed : speed, 0}; 
-    usize id = entity_create(position, size, sprite_offset,velocity, COLLISION_LAYER_ENEMY, enemy_mask, false, animation_id, NULL, on_hit_static);
-    Entity *entity = entity_get(id);
-    entity->is_enraged = is_enraged;
+    Entity_Desc desc = {
+        .size = { size[0], size[1] },
+        .sprite_offset = { sprite_offset[0], sprite_offset[1] },
+        .velocity = { is_flipped ? -speed : speed, 0 },
+        .animation_id = animation_id,
+        .on_hit_static = enemy_on_hit_static,
+        .collision_layer = COLLISION_LAYER_ENEMY,
+        .collision_mask = enemy_mask,
+        .tags = GAME_TAG_ENEMY | (is_small ? GAME_TAG_SMALL : 0) | (is_enraged ? GAME_TAG_ENRAGED : 0) | (is_flipped ? GAME_TAG_FLIPPED : 0),
+        .is_bounded = true,
+    };
+    enemy_prefab_ids[is_small][is_enraged][is_flipped] = entity_prefab_create(&desc);
+}
+
+void spawn_enemy(bool is_small, bool is_enraged, bool is_flipped) {
+	f32 spawn_x = is_flipped ? width : 0;
+    vec2 position = {spawn_x, (height - 64)};
+
+    // Can run inside physics callbacks, so the entity is created at the next entity_commands_flush.
+    entity_command_spawn(enemy_prefab_ids[is_small][is_enraged][is_flipped], position);
 }
 
 void fire_on_hit(Body *self, Body *other, Hit hit) {
 	if (other->collision_layer == COLLISION_LAYER_ENEMY) {
         if (other->is_active) {
-            Entity *enemy = entity_get(other->entity_id);
-            bool is_small = enemy->animation_id == anim_enemy_small_id || enemy->animation_id == anim_enemy_small_enraged_id;
+            bool is_small = entity_has_tags(other->id, GAME_TAG_SMALL);
             bool is_flipped = rand() % 100 >= 50;
             spawn_enemy(is_small, true, is_flipped);
-            entity_destroy(other->entity_id);
+            entity_command_destroy(other->id);
         }
 	} else if (other->collision_layer == COLLISION_LAYER_PLAYER) {
-        reset();
+        should_reset = true;
     }
 }
 
+//render animated entites, entity, body and animation are columns of the same chunk
+static void render_sprites_system(void) {
+	Ecs_Query query = ecs_query(ECS_MASK(entity_components.entity) | ECS_MASK(physics_components.body) | ECS_MASK(animation_components.animation),0);
+	Ecs_View view;
+
+	while(ecs_query_next(&query,&view)) {
+		Entity *entities = ecs_view_column(&view,entity_components.entity);
+		Body *bodies = ecs_view_column(&view,physics_components.body);
+		Animation *anims = ecs_view_column(&view,animation_components.animation);
+
+		for(usize i = 0;i<view.count;++i) {
+			if(bodies[i].velocity[0] <0) {
+				anims[i].is_flipped = true;
+			} else if (bodies[i].velocity[0] >0) {
+				anims[i].is_flipped = false;
+			}
+			vec2 pos;
+			vec2_add(pos,bodies[i].aabb.position,entities[i].sprite_offset);
+
+			animation_render(&anims[i],pos,WHITE);
+		}
+	}
+}
+
 void reset(void) {
     audio_music_play(MUSIC_STAGE_1);
 
-    physics_reset();
-    entity_reset();
-
     ground_timer = 0;
     spawn_timer = 0;
     shoot_timer = 0;
 
+    // Ids are saved as well, so player_id stays valid.
+    if (level_snapshot.data && world_snapshot_load(level_snapshot.data, level_snapshot.len)) {
+        return;
+    }
+
+    physics_reset();
+    entity_reset();
+
 	player_id = entity_create((vec2){100, 200}, (vec2){24, 24}, (vec2){0, 0}, (vec2){0, 0}, COLLISION_LAYER_PLAYER, player_mask, false, (usize)-1, player_on_hit, player_on_hit_static);
 
     // Init level.
@@ -296,12 +340,16 @@ void reset(void) {
 		physics_static_body_create((vec2){16, height - 64}, (vec2){32, 64}, COLLISION_LAYER_ENEMY_PASSTHROUGH);
 		physics_static_body_create((vec2){width - 16, height - 64}, (vec2){32, 64}, COLLISION_LAYER_ENEMY_PASSTHROUGH);
 			
+		physics_static_body_finalize();
+
 		physics_trigger_create((vec2){width * 0.5, -4}, (vec2){64, 8}, 0, fire_mask, fire_on_hit);
 	}
 
     entity_create((vec2){width * 0.5, 0}, (vec2){32, 64}, (vec2){0, 0}, (vec2){0, 0}, 0, 0, true, anim_fire_id, NULL, NULL);
     entity_create((vec2){width * 0.5 + 16, -16}, (vec2){32, 64}, (vec2){0, 0}, (vec2){0, 0}, 0, 0, true, anim_fire_id, NULL, NULL);
     entity_create((vec2){width * 0.5 - 16, -16}, (vec2){32, 64}, (vec2){0, 0}, (vec2){0, 0}, 0, 0, true, anim_fire_id, NULL, NULL);
+
+    level_snapshot = world_snapshot_save();
 }
 
 
@@ -309,11 +357,13 @@ void reset(void) {
 int main(int argc, char* argv[]) {
 	
 	time_init(60);
+	frame_arena_init(FRAME_ARENA_CAPACITY);
 	config_init();
-	SDL_Window* window = render_init();
+	SDL_Window* window = render_init(DEFAULT_BATCH_QUADS);
+	ecs_init();
 	physics_init();
-	entity_init();
 	animation_init();
+	entity_init();
 	audio_init();
 
 	audio_sound_load(&SOUND_JUMP,"assets/jump.wav");
@@ -330,6 +380,7 @@ int main(int argc, char* argv[]) {
 	SDL_GetWindowSize(window,&window_width,&window_height);
 	width = window_width / render_get_scale();
  	height = window_height / render_get_scale();
+	entity_cull_set_bounds((vec2){-CULL_MARGIN, -CULL_MARGIN}, (vec2){width + CULL_MARGIN, height + CULL_MARGIN});
 
 	//animation initialization
 	
@@ -340,12 +391,13 @@ int main(int argc, char* argv[]) {
 	Sprite_Sheet sprite_sheet_props;
 	Sprite_Sheet sprite_sheet_fire;
 
-	render_sprite_sheet_init(&sprite_sheet_player,"assets/player.png",24,24);
-	render_sprite_sheet_init(&sprite_sheet_map, "assets/map.png",640,360);
-	render_sprite_sheet_init(&sprite_sheet_enemy_small, "assets/enemy_small.png", 24, 24);
-	render_sprite_sheet_init(&sprite_sheet_enemy_large, "assets/enemy_large.png", 40, 40);
-	render_sprite_sheet_init(&sprite_sheet_props, "assets/props_16x16.png", 16, 16);
-	render_sprite_sheet_init(&sprite_sheet_fire,"assets/fire.png", 32, 64);
+	render_sprite_sheet_load(&sprite_sheet_player,"assets/player.png",24,24);
+	render_sprite_sheet_load(&sprite_sheet_map, "assets/map.png",640,360);
+	render_sprite_sheet_load(&sprite_sheet_enemy_small, "assets/enemy_small.png", 24, 24);
+	render_sprite_sheet_load(&sprite_sheet_enemy_large, "assets/enemy_large.png", 40, 40);
+	render_sprite_sheet_load(&sprite_sheet_props, "assets/props_16x16.png", 16, 16);
+	render_sprite_sheet_load(&sprite_sheet_fire,"assets/fire.png", 32, 64);
+	render_atlas_build();
 
 	usize adef_anim_fire_id = animation_def_create(&sprite_sheet_fire, 0.1,0,(u8[]){1,2,3,4,5,6,7},7);
 	usize adef_player_walk_id = animation_def_create(&sprite_sheet_player,0.1,0,(u8[]){1,2,3,4,5,6,7},7);
@@ -377,10 +429,50 @@ int main(int argc, char* argv[]) {
             .sfx = SOUND_SHOOT
     };
 
+    // Bodies store callbacks by registration order, so register them before any prefab or body uses them.
+    physics_on_hit_register(player_on_hit);
+    physics_on_hit_register(projectile_on_hit);
+    physics_on_hit_register(fire_on_hit);
+    physics_on_hit_static_register(player_on_hit_static);
+    physics_on_hit_static_register(projectile_on_hit_static);
+    physics_on_hit_static_register(enemy_on_hit_static);
+
+    // Init prefabs.
+    for (usize i = 0; i < WEAPON_TYPE_COUNT; ++i) {
+        Weapon *weapon = &weapons[i];
+        // Weapons left zeroed are not set up yet, their animation id 0 would be a real animation.
+        if (weapon->fire_rate == 0) {
+            continue;
+        }
+        for (usize is_flipped = 0; is_flipped < 2; ++is_flipped) {
+            Entity_Desc desc = {
+                .size = { weapon->sprite_size[0], weapon->sprite_size[1] },
+                .sprite_offset = { weapon->sprite_offset[0], weapon->sprite_offset[1] },
+                .velocity = { is_flipped ? -weapon->projectile_speed : weapon->projectile_speed, 0 },
+                .animation_id = weapon->projectile_animation_id,
+                .on_hit = projectile_on_hit,
+                .on_hit_static = projectile_on_hit_static,
+                .collision_layer = COLLISION_LAYER_PROJECTILE,
+                .collision_mask = projectile_mask,
+                .lifetime = PROJECTILE_LIFETIME,
+                .is_kinematic = true,
+                .is_projectile = true,
+                .tags = GAME_TAG_PROJECTILE | (weapon->projectile_type == PROJECTILE_TYPE_SMALL ? GAME_TAG_PROJECTILE_SMALL : 0),
+                .is_bounded = true,
+            };
+            weapon->projectile_prefab_ids[is_flipped] = entity_prefab_create(&desc);
+        }
+    }
+
+    for (usize i = 0; i < 8; ++i) {
+        enemy_prefab_create(i & 1, (i >> 1) & 1, (i >> 2) & 1);
+    }
+
 	reset();
 
 	while (!shouldQuit) {
 		time_update();
+		frame_arena_begin();
 		SDL_Event event;
 
 		while (SDL_PollEvent(&event)) {
@@ -400,21 +492,28 @@ int main(int argc, char* argv[]) {
         spawn_timer -= global.time.delta;
         ground_timer -= global.time.delta;
 
-		Entity* player = entity_get(player_id);
-		Body* player_body = physics_body_get(player->body_id);
+		Body* player_body = physics_body_get(player_id);
 		
 
 		if(player_body->velocity[0] != 0) {
-			player->animation_id = anim_player_walk_id;
+			entity_set_animation(player_id,anim_player_walk_id);
 		} else {
-			player->animation_id = anim_player_idle_id;
+			entity_set_animation(player_id,anim_player_idle_id);
 		}
 
 		 
 
+		// Adding the animation component the first time moves the player's row.
+		player_body = physics_body_get(player_id);
+
 		input_update();
 		input_handle(player_body);
+		enemy_speed_system();
 		physics_update();
+		if (should_reset) {
+			should_reset = false;
+			reset();
+		}
 		animation_update(global.time.delta);
 
 		//spawn enemies
@@ -431,55 +530,45 @@ int main(int argc, char* argv[]) {
 
 		}
 
+		entity_cull_update(global.time.delta);
+
+		// sync point for structural changes recorded by physics callbacks and spawners
+		entity_commands_flush();
+
 		render_begin();
 
-		render_sprite_sheet_frame(&sprite_sheet_map,0,0,(vec2){width/2,height/2},false,(vec4){1.0,1.0,1.0,0.2},texture_slots);
+		render_sprite_sheet_frame(&sprite_sheet_map,0,0,(vec2){width/2,height/2},false,(vec4){1.0,1.0,1.0,0.2});
 
 		//debug render bounding boxes
+#if RENDER_DEBUG
 		{
-			for(usize i = 0;i<entity_count();++i) {
-				Entity *entity = entity_get(i);
-				Body *body = physics_body_get(entity->body_id);
-				if(body->is_active) {
-					render_aabb((f32*)&body->aabb,TURQUOISE);
-				} else {
-					render_aabb((f32*)&body->aabb,RED);
+			Ecs_Query query = ecs_query(ECS_MASK(physics_components.body),0);
+			Ecs_View view;
+			while(ecs_query_next(&query,&view)) {
+				Body *bodies = ecs_view_column(&view,physics_components.body);
+				for(usize i = 0;i<view.count;++i) {
+					if(bodies[i].is_active) {
+						render_debug_aabb((f32*)&bodies[i].aabb,TURQUOISE);
+					} else {
+						render_debug_aabb((f32*)&bodies[i].aabb,RED);
+					}
 				}
-
 			}
 			
 			for(usize i =0;i<physics_static_body_count();++i) {
-				render_aabb((f32*)physics_static_body_get(i),WHITE);
+				render_debug_aabb((f32*)physics_static_body_get(i),WHITE);
 			}
 		}
-		//render animated entites
-		{
-			for(usize i = 0;i<entity_count();++i) {
-				Entity *entity = entity_get(i);
-				if(!entity->is_active) {
-					continue;
-				}
-				if(entity->animation_id == (usize)-1) {
-					continue;
-				}
-
-				Body *body = physics_body_get(entity->body_id);
-				Animation *anim = animation_get(entity->animation_id);
+#endif
+		render_sprites_system();
 
-				if(body->velocity[0] <0) {
-					anim->is_flipped = true;
-				} else if (body->velocity[0] >0) {
-					anim->is_flipped = false;
-				}
-				vec2 pos;
-				vec2_add(pos,body->aabb.position,entity->sprite_offset);
+		render_end(window);
 
-				animation_render(anim,pos,WHITE,texture_slots);			
-			}
-		}
-
-		render_end(window,texture_slots);
 		time_update_late();
 	}
+
+	world_snapshot_free(&level_snapshot);
+	printf("Frame arena high water: %zu of %d bytes\n", frame_arena_high_water(), FRAME_ARENA_CAPACITY);
+	memory_dump();
 	return 0;
 }